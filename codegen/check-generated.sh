@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Generates the code of NFs with each of the unverified codegen options, and
+# checks that it builds, since the NFs' Makefiles regenerate it on every build:
+# - VIGOR_VECTOR=records, for the record groups of dataspec.ml files;
+# - VIGOR_MAP, for the map functions specialized per key type;
+# - VIGOR_PACKED_KEYS, for the equality and hash functions of small keys;
+# - VIGOR_FIXED_<PARAM>, for the static records and map masks of fixed
+#   capacities.
+# Needs what the NFs need to build, i.e. OCaml with CIL, and DPDK.
+
+set -euo pipefail
+
+SCRIPT_DIR=$(cd $(dirname ${BASH_SOURCE[0]}) && pwd)
+LOG_DIR=$(mktemp -d)
+
+FAILURES=0
+
+# Builds the given NF with the given make variables
+function check_nf {
+  NF=$1
+  shift
+  LOG="$LOG_DIR/$NF-$(echo "$@" | tr -c 'a-zA-Z0-9=\n' '_').log"
+
+  if make -C "$SCRIPT_DIR/../$NF" -j$(nproc) "$@" >"$LOG" 2>&1; then
+    echo "OK:   $NF $*"
+  else
+    echo "FAIL: $NF $*, see $LOG"
+    FAILURES=$((FAILURES + 1))
+  fi
+}
+
+
+# The generated code without any option, as a baseline
+check_nf vignat
+check_nf vigfw
+check_nf viglb
+
+# Vectors stored as records, with their double chain or not
+check_nf vigfw VIGOR_VECTOR=records
+check_nf viglb VIGOR_VECTOR=records VIGOR_DCHAIN=lazy
+check_nf vigbridge VIGOR_VECTOR=records VIGOR_DCHAIN=lazy
+
+# Maps specialized per key type
+for MAP in bucketed robinhood swiss; do
+  check_nf vignat VIGOR_MAP=$MAP
+  check_nf viglb VIGOR_MAP=$MAP
+done
+
+# Packed keys, with the libVig map and with a specialized one
+check_nf vignat EXTRA_CFLAGS=-DVIGOR_PACKED_KEYS
+check_nf viglb EXTRA_CFLAGS=-DVIGOR_PACKED_KEYS VIGOR_MAP=robinhood
+
+# Fixed capacities, with static records and with allocated ones
+check_nf vigfw VIGOR_VECTOR=records \
+               EXTRA_CFLAGS="-DVIGOR_BATCH_SIZE=32 -DVIGOR_FIXED_MAX_FLOWS=65536"
+check_nf vignat VIGOR_VECTOR=records VIGOR_DCHAIN=lazy VIGOR_MAP=swiss \
+                EXTRA_CFLAGS="-DVIGOR_BATCH_SIZE=32 -DVIGOR_FIXED_MAX_FLOWS=65536 -DVIGOR_PACKED_KEYS"
+check_nf vignat VIGOR_VECTOR=records \
+                EXTRA_CFLAGS="-DVIGOR_BATCH_SIZE=32 -DVIGOR_FIXED_MAX_FLOWS=65536 -DVIGOR_MULTICORE"
+check_nf viglb VIGOR_MAP=robinhood EXTRA_CFLAGS=-DVIGOR_FIXED_FLOW_CAPACITY=65536
+
+# Leave the NFs as they are built by default
+for NF in vignat vigfw viglb vigbridge; do
+  make -C "$SCRIPT_DIR/../$NF" -j$(nproc) >/dev/null 2>&1 || true
+done
+
+if [ $FAILURES -ne 0 ]; then
+  echo "$FAILURES builds failed."
+  exit 1
+fi
+rm -rf "$LOG_DIR"
+echo "Done."
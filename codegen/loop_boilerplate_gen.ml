@@ -5,6 +5,7 @@ open Data_spec
 let gen_records = !Nf_data_spec.gen_records
 let containers = Nf_data_spec.containers
 let constraints = Nf_data_spec.constraints
+let record_groups = Nf_data_spec.record_groups
 
 
 let inductive_name cname = match cname with
@@ -587,6 +588,180 @@ let gen_loop_iteration_border_stub containers =
      ["&lcore_id"; "&time"]) ^ ");\n" ^
   "}"
 
+(* With the unverified VIGOR_VECTOR option, the vectors of a record group
+   store their elements of the same index in one record, along with the
+   timestamps of the group's double chain with VIGOR_DCHAIN,
+   see libvig/unverified/vector-ext.h *)
+let record_group_of name =
+  List.find_opt (fun group -> List.mem name group) record_groups
+
+let record_struct_name group = List.hd group ^ "_record"
+let records_var_name group = List.hd group ^ "_records"
+let record_stride_var_name group = List.hd group ^ "_stride"
+
+let record_member group name =
+  records_var_name group ^ " + offsetof(struct " ^
+  record_struct_name group ^ ", " ^ name ^ ")"
+
+let vector_elem_type typ =
+  if String.equal typ "uint32_t" then "uint32_t" else "struct " ^ typ
+
+let record_group_capacity containers group =
+  let members = List.map (fun name ->
+      match List.assoc_opt name containers with
+      | Some (Vector (_, cap, _)) -> (cap, false)
+      | Some (DChain cap) -> (cap, true)
+      | _ -> failwith ("Only vectors and double chains can be in a record: " ^
+                       name))
+      group
+  in
+  let cap = fst (List.hd members) in
+  if List.exists (fun (c, _) -> not (String.equal c cap)) members then
+    failwith ("The containers of a record must have the same capacity: " ^
+              String.concat ", " group);
+  if List.length (List.filter snd members) > 1 ||
+     List.for_all snd members then
+    failwith ("A record needs vectors, and at most one double chain: " ^
+              String.concat ", " group);
+  cap
+
+let gen_record_structs containers =
+  concat_flatten_map ""
+    (fun group ->
+       ignore (record_group_capacity containers group);
+       ("struct " ^ record_struct_name group ^ " {\n")::
+       (List.flatten (List.map (fun name ->
+            match List.assoc name containers with
+            | Vector (typ, _, _) ->
+              ["  " ^ vector_elem_type typ ^ " " ^ name ^ ";\n"]
+            | _ -> ["#ifdef VIGOR_DCHAIN\n";
+                    "  struct dchain_stamps " ^ name ^ ";\n";
+                    "#endif//VIGOR_DCHAIN\n"])
+            group)) @
+       ["};\n"])
+    record_groups []
+
+(* Capacities can also be fixed at build time, e.g. with
+   -DVIGOR_FIXED_MAX_FLOWS=65536 for the max_flows parameter of alloc_state,
+   which then fails if it is given another one. With VIGOR_VECTOR, the records
+   of the groups whose capacity is fixed are then static arrays, whose
+   elements NFs can reach at constant offsets without going through the
+   vectors, except with VIGOR_MULTICORE or VIGOR_HUGEPAGES since each lcore
+   allocates its own state, on its own NUMA node *)
+let is_capacity_of name cnt =
+  match cnt with
+  | Map (_, cap, _)
+  | Vector (_, cap, _)
+  | DChain cap -> String.equal cap name
+  | CHT (depth, height) -> String.equal depth name || String.equal height name
+  | _ -> false
+
+let capacity_params containers =
+  List.map fst
+    (List.filter (fun (name, cnt) ->
+         match cnt with
+         | Int | UInt | UInt32 ->
+           List.exists (fun (_, c) -> is_capacity_of name c) containers
+         | _ -> false)
+        containers)
+
+let fixed_capacity_macro cap = "VIGOR_FIXED_" ^ String.uppercase_ascii cap
+
+let static_record_groups containers =
+  List.filter (fun group ->
+      List.mem (record_group_capacity containers group)
+        (capacity_params containers))
+    record_groups
+
+let static_records_macro group =
+  "STATE_STATIC_" ^ String.uppercase_ascii (records_var_name group)
+let static_records_var_name group = "state_" ^ records_var_name group
+let record_stride_macro group =
+  String.uppercase_ascii (record_struct_name group) ^ "_STRIDE"
+let static_element_fun_name name = "state_" ^ name ^ "_at"
+
+let gen_fixed_capacity_checks containers =
+  concat_flatten_map ""
+    (fun cap ->
+       let macro = fixed_capacity_macro cap in
+       ["#ifdef " ^ macro ^ "\n";
+        "  if (" ^ cap ^ " != " ^ macro ^ ") {\n";
+        "    NF_INFO(\"" ^ cap ^ " must be %d, as fixed at build time\", " ^
+        "(int)(" ^ macro ^ "));\n";
+        "    return NULL;\n";
+        "  }\n";
+        "#endif//" ^ macro ^ "\n"])
+    (capacity_params containers) []
+
+let gen_static_records_decls containers =
+  concat_flatten_map ""
+    (fun group ->
+       let cap = record_group_capacity containers group in
+       let stride = record_stride_macro group in
+       let records = static_records_var_name group in
+       ["#if defined(VIGOR_VECTOR) && defined(" ^
+        fixed_capacity_macro cap ^ ") && \\\n";
+        "    !defined(VIGOR_MULTICORE) && !defined(VIGOR_HUGEPAGES)\n";
+        "#define " ^ static_records_macro group ^ "\n";
+        "#define " ^ stride ^ " VECTOR_RECORD_STRIDE(sizeof(struct " ^
+        record_struct_name group ^ "))\n";
+        "extern char " ^ records ^ "[];\n"] @
+       (List.flatten (List.map (fun name ->
+            match List.assoc name containers with
+            | Vector (typ, _, _) ->
+              ["static inline " ^ vector_elem_type typ ^ "* " ^
+               static_element_fun_name name ^ "(int index) {\n";
+               "  return (" ^ vector_elem_type typ ^ "*)(" ^ records ^
+               " + (size_t)index * " ^ stride ^ " +\n";
+               "      offsetof(struct " ^ record_struct_name group ^ ", " ^
+               name ^ "));\n";
+               "}\n"]
+            | _ -> [])
+            group)) @
+       ["#endif\n"])
+    (static_record_groups containers) []
+
+let gen_static_records_defs containers =
+  concat_flatten_map ""
+    (fun group ->
+       let cap = record_group_capacity containers group in
+       ["#ifdef " ^ static_records_macro group ^ "\n";
+        "char " ^ static_records_var_name group ^ "[(size_t)" ^
+        fixed_capacity_macro cap ^ " * " ^ record_stride_macro group ^ "]\n";
+        "    __attribute__((aligned(64)));\n";
+        "#endif//" ^ static_records_macro group ^ "\n"])
+    (static_record_groups containers) []
+
+(* With VIGOR_MAP, the map functions specialized for a key type take the mask
+   of its maps as a constant if they all have the same capacity, fixed at build
+   time, see MAP_TYPED_FUNCTIONS_FIXED and fill_impl_file in main.ml *)
+let fixed_map_capacity_macro typ = "STATE_FIXED_MAP_CAPACITY_" ^ typ
+
+let fixed_map_capacities containers =
+  let maps = List.flatten (List.map (fun (_, cnt) ->
+      match cnt with
+      | Map (typ, cap, _) -> [(typ, cap)]
+      | _ -> [])
+      containers)
+  in
+  List.sort_uniq compare
+    (List.filter (fun (typ, cap) ->
+         List.mem cap (capacity_params containers) &&
+         List.for_all (fun (t, c) ->
+             not (String.equal t typ) || String.equal c cap)
+           maps)
+        maps)
+
+let gen_fixed_map_capacities containers =
+  concat_flatten_map ""
+    (fun (typ, cap) ->
+       ["#if defined(VIGOR_MAP) && defined(" ^ fixed_capacity_macro cap ^
+        ")\n";
+        "#define " ^ fixed_map_capacity_macro typ ^ " " ^
+        fixed_capacity_macro cap ^ "\n";
+        "#endif\n"])
+    (fixed_map_capacities containers) []
+
 let gen_struct containers =
   "struct State {\n" ^
   (concat_flatten_map ""
@@ -629,25 +804,71 @@ let gen_allocation containers =
   in
   (gen_allocation_proto containers) ^ "\n{\n" ^
   "  if (allocated_nf_state != NULL) return allocated_nf_state;\n" ^
+  (gen_fixed_capacity_checks containers) ^
   "  struct State* ret = malloc(sizeof(struct State));\n" ^
   "  if (ret == NULL) return NULL;\n" ^
+  (if record_groups = [] then "" else
+     "#ifdef VIGOR_VECTOR\n" ^
+     (concat_flatten_map ""
+        (fun group ->
+           let cap = record_group_capacity containers group in
+           let allocation =
+             ["  char* " ^ records_var_name group ^
+              " = vector_allocate_records(" ^ record_stride_var_name group ^
+              ", " ^ cap ^ ");\n";
+              abort_on_null (records_var_name group)]
+           in
+           ("  unsigned " ^ record_stride_var_name group ^
+            " = vector_record_stride(sizeof(struct " ^
+            record_struct_name group ^ "));\n")::
+           (if List.mem group (static_record_groups containers) then
+              ["#ifdef " ^ static_records_macro group ^ "\n";
+               "  char* " ^ records_var_name group ^ " = " ^
+               static_records_var_name group ^ ";\n";
+               "#else//" ^ static_records_macro group ^ "\n"] @
+              allocation @
+              ["#endif//" ^ static_records_macro group ^ "\n"]
+            else allocation))
+        record_groups []) ^
+     "#endif//VIGOR_VECTOR\n") ^
   (concat_flatten_map ""
      (fun (name, cnt) ->
         match cnt with
         | Map (typ, cap, _) ->
           ["  ret->" ^ name ^ " = NULL;\n";
+           "#ifdef VIGOR_MAP\n";
+           abort_on_null ("map_allocate_sized(" ^ eq_fun_name typ ^
+                          ", " ^ hash_fun_name typ ^
+                          ", sizeof(struct " ^ typ ^ "), " ^ cap ^
+                          ", &(ret->" ^ name ^ "))");
+           "#else//VIGOR_MAP\n";
            abort_on_null ("map_allocate(" ^ eq_fun_name typ ^
                           ", " ^ hash_fun_name typ ^ ", " ^ cap ^
-                          ", &(ret->" ^ name ^ "))")]
+                          ", &(ret->" ^ name ^ "))");
+           "#endif//VIGOR_MAP\n"]
         | Vector (typ, cap, _) ->
           let typ_size =
             if String.equal typ "uint32_t" then
               "sizeof(uint32_t)" else
               "sizeof(struct " ^ typ ^ ")"
           in
-          ["  ret->" ^ name ^ " = NULL;\n";
-           abort_on_null ("vector_allocate(" ^ typ_size ^ ", " ^ cap ^
-                          ", " ^ alloc_fun_name typ ^ ", &(ret->" ^ name ^ "))")]
+          let allocation =
+            abort_on_null ("vector_allocate(" ^ typ_size ^ ", " ^ cap ^
+                           ", " ^ alloc_fun_name typ ^ ", &(ret->" ^ name ^ "))")
+          in
+          ("  ret->" ^ name ^ " = NULL;\n")::
+          (match record_group_of name with
+           | None -> [allocation]
+           | Some group ->
+             ["#ifdef VIGOR_VECTOR\n";
+              abort_on_null ("vector_allocate_in(" ^ typ_size ^ ", " ^ cap ^
+                             ", " ^ alloc_fun_name typ ^ ", " ^
+                             record_member group name ^ ", " ^
+                             record_stride_var_name group ^
+                             ", &(ret->" ^ name ^ "))");
+              "#else//VIGOR_VECTOR\n";
+              allocation;
+              "#endif//VIGOR_VECTOR\n"])
         | CHT (depth, height) ->
           ["  ret->" ^ name ^ " = NULL;\n";
            abort_on_null ("vector_allocate(sizeof(uint32_t), " ^
@@ -656,9 +877,22 @@ let gen_allocation containers =
            "  " ^ abort_on_null ("cht_fill_cht(ret->" ^
                                  name ^ ", " ^ height ^
                                  ", " ^ depth ^ ")")]
-        | DChain cap -> ["  ret->" ^ name ^ " = NULL;\n";
-                         abort_on_null ("dchain_allocate(" ^
-                                        cap ^ ", &(ret->" ^ name ^ "))")]
+        | DChain cap ->
+          let allocation =
+            abort_on_null ("dchain_allocate(" ^ cap ^ ", &(ret->" ^ name ^ "))")
+          in
+          ("  ret->" ^ name ^ " = NULL;\n")::
+          (match record_group_of name with
+           | None -> [allocation]
+           | Some group ->
+             ["#if defined(VIGOR_VECTOR) && defined(VIGOR_DCHAIN)\n";
+              abort_on_null ("dchain_allocate_in(" ^ cap ^ ", " ^
+                             record_member group name ^ ", " ^
+                             record_stride_var_name group ^
+                             ", &(ret->" ^ name ^ "))");
+              "#else\n";
+              allocation;
+              "#endif\n"])
         | Int
         | UInt
         | UInt32 -> ["  ret->" ^ name ^ " = " ^ name ^ ";\n"]
@@ -811,6 +1045,18 @@ let () =
   fprintf cout "#include \"loop.h\"\n";
   fprintf cout "%s\n" (gen_struct containers);
   fprintf cout "%s;\n" (gen_allocation_proto containers);
+  if record_groups <> [] then begin
+    fprintf cout "#ifdef VIGOR_VECTOR\n";
+    fprintf cout "#include <stddef.h>\n";
+    fprintf cout "#include \"libvig/unverified/vector-ext.h\"\n";
+    fprintf cout "#ifdef VIGOR_DCHAIN\n";
+    fprintf cout "#include \"libvig/unverified/double-chain-ext.h\"\n";
+    fprintf cout "#endif//VIGOR_DCHAIN\n";
+    fprintf cout "%s" (gen_record_structs containers);
+    fprintf cout "#endif//VIGOR_VECTOR\n";
+    fprintf cout "%s" (gen_static_records_decls containers)
+  end;
+  fprintf cout "%s" (gen_fixed_map_capacities containers);
   fprintf cout "#endif//_STATE_H_INCLUDED_\n";
   close_out cout;
   let cout = open_out "loop.c" in
@@ -829,6 +1075,28 @@ let () =
   fprintf cout "#include \"state.h\"\n";
   fprintf cout "#include <stdlib.h>\n";
   fprintf cout "#include \"libvig/verified/boilerplate-util.h\"\n";
+  fprintf cout "#include \"libvig/verified/lcore-local.h\"\n";
+  if capacity_params containers <> [] then begin
+    fprintf cout "#if %s\n"
+      (String.concat " || "
+         (List.map (fun cap -> "defined(" ^ fixed_capacity_macro cap ^ ")")
+            (capacity_params containers)));
+    fprintf cout "#include \"nf-log.h\"\n";
+    fprintf cout "#endif\n"
+  end;
+  fprintf cout "#ifdef VIGOR_MAP\n";
+  fprintf cout "#include \"libvig/unverified/map-ext.h\"\n";
+  fprintf cout "#endif//VIGOR_MAP\n";
+  fprintf cout "#ifdef VIGOR_VECTOR\n";
+  fprintf cout "#include <stddef.h>\n";
+  fprintf cout "#include \"libvig/unverified/vector-ext.h\"\n";
+  fprintf cout "#endif//VIGOR_VECTOR\n";
+  fprintf cout "#ifdef VIGOR_DCHAIN\n";
+  fprintf cout "#include \"libvig/unverified/double-chain-ext.h\"\n";
+  fprintf cout "#endif//VIGOR_DCHAIN\n";
+  fprintf cout "#ifdef VIGOR_HUGEPAGES\n";
+  fprintf cout "#include \"libvig/unverified/alloc.h\"\n";
+  fprintf cout "#endif//VIGOR_HUGEPAGES\n";
   fprintf cout "#ifdef KLEE_VERIFICATION\n";
   fprintf cout "#include \"libvig/models/verified/double-chain-control.h\"\n";
   fprintf cout "#include \"libvig/models/verified/ether.h\"\n";
@@ -836,7 +1104,8 @@ let () =
   fprintf cout "#include \"libvig/models/verified/vector-control.h\"\n";
   fprintf cout "#include \"libvig/models/verified/lpm-dir-24-8-control.h\"\n";
   fprintf cout "#endif//KLEE_VERIFICATION\n";
-  fprintf cout "struct State* allocated_nf_state = NULL;\n";
+  fprintf cout "VIGOR_LCORE_LOCAL struct State* allocated_nf_state = NULL;\n";
+  fprintf cout "%s" (gen_static_records_defs containers);
   fprintf cout "%s\n" (gen_inv_c_functions constraints containers);
   fprintf cout "%s\n" (gen_allocation containers);
   fprintf cout "#ifdef KLEE_VERIFICATION\n";
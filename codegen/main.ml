@@ -400,6 +400,21 @@ let gen_hash compinfo =
   "  return hash;\n" ^
   "}"
 
+(* Flows identified by IPv4 addresses and ports can be hashed the same way as
+   devices do with RSS, see libvig/unverified/rss.h *)
+let is_rss_flow compinfo =
+  List.for_all (fun name ->
+      List.exists (fun {fname;_} -> String.equal fname name) compinfo.cfields)
+    ["src_ip"; "dst_ip"; "src_port"; "dst_port"]
+
+let gen_rss_hash compinfo =
+  "unsigned " ^ (hash_fun_name compinfo) ^ "(void* obj)\n" ^
+  "{\n" ^
+  "  struct " ^ compinfo.cname ^ "* id = (struct " ^ compinfo.cname ^
+  "*) obj;\n" ^
+  "  return rss_flow_hash(id->src_ip, id->dst_ip, id->src_port, id->dst_port);\n" ^
+  "}"
+
 let gen_hash_dummy compinfo =
   let strdescrs = (strdescrs_name compinfo) in
   let nests = (nest_descrs_name compinfo) in
@@ -575,18 +590,163 @@ let gen_log_fun_decl compinfo =
   "  p(\"}\");\n"
 
 
+(* With VIGOR_PACKED_KEYS, structs of up to packed_key_max_size bytes are
+   compared and hashed as whole words, with their padding masked out, see
+   libvig/unverified/packed-keys.h *)
+let packed_key_max_size = 32
+
+(* The byte ranges of a type that hold fields, as opposed to padding *)
+let rec payload_ranges typ base =
+  let typ = unrollType typ in
+  match typ with
+  | TInt _ | TEnum _ -> [(base, (bitsSizeOf typ) / 8)]
+  | TArray (elt_t, Some _, _) when isIntegralType elt_t ->
+    [(base, (bitsSizeOf typ) / 8)]
+  | TComp (cinfo, _) when cinfo.cstruct ->
+    List.concat (List.map (fun finfo ->
+        if finfo.fbitfield <> None then raise Exit;
+        let (off, _) = bitsOffset typ (Field (finfo, NoOffset)) in
+        payload_ranges finfo.ftype (base + off / 8))
+        cinfo.cfields)
+  | _ -> raise Exit
+
+(* The size of the struct and its words as (offset, width, mask of the bytes
+   that are not padding), or None if it cannot be packed *)
+let packed_key_words compinfo =
+  let typ = TComp (compinfo, []) in
+  try
+    let size = (bitsSizeOf typ) / 8 in
+    if size = 0 || size > packed_key_max_size || size mod 4 <> 0 then None
+    else
+      let ranges = payload_ranges typ 0 in
+      let rec byte_mask offset width i =
+        if i = width then 0L
+        else
+          let b = offset + i in
+          let rest = byte_mask offset width (i + 1) in
+          if List.exists (fun (o, s) -> o <= b && b < o + s) ranges then
+            Int64.logor rest (Int64.shift_left 0xffL (8 * i))
+          else rest
+      in
+      let rec words offset =
+        if offset >= size then []
+        else
+          let width = if size - offset >= 8 then 8 else 4 in
+          (offset, width, byte_mask offset width 0) :: words (offset + width)
+      in
+      Some (size, words 0)
+  with Exit | SizeOfError _ -> None
+
+let packed_load ptr (offset, width, _) =
+  (if width = 8 then "packed_key_word(" else "packed_key_word32(") ^
+  ptr ^ ", " ^ (string_of_int offset) ^ ")"
+
+let apply_packed_mask exp (_, width, mask) =
+  if width = 8 then
+    if mask = -1L then exp else sprintf "(%s & 0x%016LxULL)" exp mask
+  else
+    if mask = 0xffffffffL then exp else sprintf "(%s & 0x%08LxU)" exp mask
+
+let packed_key_assert compinfo size =
+  "  _Static_assert(sizeof(struct " ^ compinfo.cname ^ ") == " ^
+  (string_of_int size) ^ ",\n" ^
+  "                 \"codegen assumed another layout of struct " ^
+  compinfo.cname ^ "\");\n"
+
+let gen_packed_eq_function compinfo (size, words) =
+  "bool " ^ (eq_fun_name compinfo) ^ "(void* a, void* b)\n" ^
+  "{\n" ^
+  (packed_key_assert compinfo size) ^
+  "  return (" ^
+  (String.concat " |\n          " (List.map (fun word ->
+       (* The masks of a and b are the same, so mask their difference once *)
+       apply_packed_mask ("(" ^ (packed_load "a" word) ^ " ^ " ^
+                          (packed_load "b" word) ^ ")") word)
+      words)) ^
+  ") == 0;\n" ^
+  "}"
+
+let gen_packed_hash compinfo (size, words) =
+  "unsigned " ^ (hash_fun_name compinfo) ^ "(void* obj)\n" ^
+  "{\n" ^
+  (packed_key_assert compinfo size) ^
+  "  unsigned long long hash = 0;\n" ^
+  (String.concat "" (List.map (fun ((_, width, _) as word) ->
+       if width = 8 then
+         "  hash = __builtin_ia32_crc32di(hash, " ^
+         (apply_packed_mask (packed_load "obj" word) word) ^ ");\n"
+       else
+         "  hash = __builtin_ia32_crc32si((unsigned)hash, " ^
+         (apply_packed_mask (packed_load "obj" word) word) ^ ");\n")
+      words)) ^
+  "  return (unsigned)hash;\n" ^
+  "}"
+
+(* Map functions specialized for maps with this struct as keys, for the
+   unverified map implementations, see libvig/unverified/map-typed.h *)
+let gen_map_typed_declarations compinfo =
+  "MAP_TYPED_DECLARATIONS(" ^ compinfo.cname ^ ")"
+
+(* With the mask of the maps as a constant if state.h, which stateless NFs do
+   not have, says that their capacity is fixed at build time, see
+   gen_fixed_map_capacities in loop_boilerplate_gen.ml *)
+let gen_map_typed_functions compinfo =
+  let fixed = "STATE_FIXED_MAP_CAPACITY_" ^ compinfo.cname in
+  "#if __has_include(\"state.h\")\n" ^
+  "#  include \"state.h\"\n" ^
+  "#endif\n" ^
+  "#ifdef " ^ fixed ^ "\n" ^
+  "MAP_TYPED_FUNCTIONS_FIXED(" ^ compinfo.cname ^ ", " ^ fixed ^ ")\n" ^
+  "#else//" ^ fixed ^ "\n" ^
+  "MAP_TYPED_FUNCTIONS(" ^ compinfo.cname ^ ")\n" ^
+  "#endif//" ^ fixed
+
 let fill_impl_file compinfo impl_fname header_fname =
   let cout = open_out impl_fname in
   ignore (P.fprintf cout "#include \"%s\"\n\n" header_fname);
   ignore (P.fprintf cout "#include <stdint.h>\n\n");
-  ignore (P.fprintf cout "%s\n\n" (gen_eq_function compinfo));
+  let packed_words = packed_key_words compinfo in
+  begin match packed_words with
+    | Some words ->
+      ignore (P.fprintf cout "#ifdef VIGOR_PACKED_KEYS\n");
+      ignore (P.fprintf cout "#include \"libvig/unverified/packed-keys.h\"\n\n");
+      ignore (P.fprintf cout "%s\n\n" (gen_packed_eq_function compinfo words));
+      ignore (P.fprintf cout "#else//VIGOR_PACKED_KEYS\n\n");
+      ignore (P.fprintf cout "%s\n\n" (gen_eq_function compinfo));
+      ignore (P.fprintf cout "#endif//VIGOR_PACKED_KEYS\n\n")
+    | None ->
+      ignore (P.fprintf cout "%s\n\n" (gen_eq_function compinfo))
+  end;
   ignore (P.fprintf cout "%s\n\n" (gen_alloc_function compinfo));
   ignore (P.fprintf cout "#ifdef KLEE_VERIFICATION\n");
   ignore (P.fprintf cout "%s\n" (gen_str_field_descrs compinfo));
   ignore (P.fprintf cout "%s\n\n" (gen_hash_dummy compinfo));
   ignore (P.fprintf cout "#else//KLEE_VERIFICATION\n\n");
-  ignore (P.fprintf cout "%s\n\n" (gen_hash compinfo));
+  let gen_field_hash () =
+    match packed_words with
+    | Some words ->
+      ignore (P.fprintf cout "#ifdef VIGOR_PACKED_KEYS\n");
+      ignore (P.fprintf cout "%s\n\n" (gen_packed_hash compinfo words));
+      ignore (P.fprintf cout "#else//VIGOR_PACKED_KEYS\n\n");
+      ignore (P.fprintf cout "%s\n\n" (gen_hash compinfo));
+      ignore (P.fprintf cout "#endif//VIGOR_PACKED_KEYS\n\n")
+    | None ->
+      ignore (P.fprintf cout "%s\n\n" (gen_hash compinfo))
+  in
+  if is_rss_flow compinfo then begin
+    ignore (P.fprintf cout "#ifdef VIGOR_RSS_HASH\n");
+    ignore (P.fprintf cout "#include \"libvig/unverified/rss.h\"\n\n");
+    ignore (P.fprintf cout "%s\n\n" (gen_rss_hash compinfo));
+    ignore (P.fprintf cout "#else//VIGOR_RSS_HASH\n\n");
+    gen_field_hash ();
+    ignore (P.fprintf cout "#endif//VIGOR_RSS_HASH\n\n")
+  end else
+    gen_field_hash ();
   ignore (P.fprintf cout "#endif//KLEE_VERIFICATION\n\n");
+  ignore (P.fprintf cout "#ifdef VIGOR_MAP\n");
+  ignore (P.fprintf cout "#include \"libvig/unverified/map-typed.h\"\n\n");
+  ignore (P.fprintf cout "%s\n" (gen_map_typed_functions compinfo));
+  ignore (P.fprintf cout "#endif//VIGOR_MAP\n");
   close_out cout;
   ()
 
@@ -617,6 +777,10 @@ let fill_header_file compinfo header_fname orig_fname def_headers =
   ignore (P.fprintf cout "%s\n\n" (gen_eq_function_decl compinfo));
   ignore (P.fprintf cout "%s\n\n" (gen_alloc_function_decl compinfo));
   ignore (P.fprintf cout "%s\n\n" (gen_log_fun_decl compinfo));
+  ignore (P.fprintf cout "#ifdef VIGOR_MAP\n");
+  ignore (P.fprintf cout "#  include \"libvig/unverified/map-ext.h\"\n\n");
+  ignore (P.fprintf cout "%s\n" (gen_map_typed_declarations compinfo));
+  ignore (P.fprintf cout "#endif//VIGOR_MAP\n\n");
   ignore (P.fprintf cout "#ifdef KLEE_VERIFICATION\n");
   ignore (P.fprintf cout "#  include <klee/klee.h>\n");
   ignore (P.fprintf cout "#  include \"libvig/models/str-descr.h\"\n\n");
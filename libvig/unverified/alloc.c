@@ -0,0 +1,90 @@
+#include "alloc.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#ifndef MAP_HUGETLB
+#  define MAP_HUGETLB 0x40000
+#endif
+
+// Only blocks of at least one hugepage are worth a mapping of their own
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+enum alloc_source {
+  ALLOC_RTE,
+  ALLOC_MMAP,
+  ALLOC_LIBC,
+};
+
+// Precedes each block, and is a cache line to keep blocks aligned
+struct alloc_header {
+  enum alloc_source source;
+  size_t mapped_size;
+} __attribute__((aligned(64)));
+
+static void* finish(void* block, enum alloc_source source, size_t mapped_size) {
+  struct alloc_header* header = (struct alloc_header*)block;
+  header->source = source;
+  header->mapped_size = mapped_size;
+  return header + 1;
+}
+
+void* vigor_malloc(size_t size) {
+  size_t total = size + sizeof(struct alloc_header);
+  if (total < size) {
+    return NULL;
+  }
+
+  void* block =
+      rte_malloc_socket("vigor", total, RTE_CACHE_LINE_SIZE, rte_socket_id());
+  if (block != NULL) {
+    return finish(block, ALLOC_RTE, 0);
+  }
+
+  if (total >= HUGEPAGE_SIZE) {
+    size_t mapped_size = (total + HUGEPAGE_SIZE - 1) & ~(size_t)(HUGEPAGE_SIZE - 1);
+    block = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (block != MAP_FAILED) {
+      return finish(block, ALLOC_MMAP, mapped_size);
+    }
+  }
+
+  if (posix_memalign(&block, sizeof(struct alloc_header), total) == 0) {
+    return finish(block, ALLOC_LIBC, 0);
+  }
+  return NULL;
+}
+
+void* vigor_calloc(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size) {
+    return NULL;
+  }
+  void* ptr = vigor_malloc(count * size);
+  if (ptr != NULL) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void vigor_free(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  struct alloc_header* header = (struct alloc_header*)ptr - 1;
+  switch (header->source) {
+    case ALLOC_RTE:
+      rte_free(header);
+      break;
+    case ALLOC_MMAP:
+      munmap(header, header->mapped_size);
+      break;
+    case ALLOC_LIBC:
+      (free)(header);
+      break;
+  }
+}
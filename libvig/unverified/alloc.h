@@ -0,0 +1,25 @@
+#ifndef _ALLOC_H_INCLUDED_
+#define _ALLOC_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Allocator for the NF state, with the (unverified) VIGOR_HUGEPAGES option.
+// Memory comes from DPDK hugepages on the NUMA node of the calling lcore,
+// which is the lcore that polls the state (see nf_init), then from
+// mmap(MAP_HUGETLB) for large blocks, and from malloc as a last resort.
+// Blocks are aligned on cache lines.
+
+void* vigor_malloc(size_t size);
+void* vigor_calloc(size_t count, size_t size);
+void vigor_free(void* ptr);
+
+// Files that include this header, after <stdlib.h>, allocate with the above.
+// Call e.g. (malloc)(size) to get the real malloc.
+#define malloc(size) vigor_malloc(size)
+#define calloc(count, size) vigor_calloc(count, size)
+#define free(ptr) vigor_free(ptr)
+// Enough for the alignments used in libVig
+#define aligned_alloc(alignment, size) vigor_malloc(size)
+
+#endif//_ALLOC_H_INCLUDED_
@@ -0,0 +1,27 @@
+#ifndef _DOUBLE_CHAIN_EXT_H_INCLUDED_
+#define _DOUBLE_CHAIN_EXT_H_INCLUDED_
+
+#include "libvig/verified/double-chain.h"
+
+// Unverified extensions to the DoubleChain API, implemented by the alternative
+// double chain in double-chain/lazy.c, selected with VIGOR_DCHAIN=lazy.
+
+// The timestamps of an index
+struct dchain_stamps {
+  vigor_time_t time;   // last rejuvenation, plus VIGOR_DCHAIN_GRANULARITY
+  vigor_time_t queued; // last move to the end of the list
+};
+
+//   The same as dchain_allocate, with the timestamps of index i at
+//   first_stamps + i*stride instead of in an array owned by the chain, e.g.
+//   in the records of the vectors indexed by the chain, see vector-ext.h.
+int dchain_allocate_in(int index_range, void* first_stamps, unsigned stride,
+                       struct DoubleChain** chain_out);
+
+//   The same as dchain_expire_one_index, but moving an index to the end of
+//   the list and freeing one both use one unit of budget, and it gives up when
+//   there is none left; expired indexes may thus remain.
+int dchain_expire_one_index_budget(struct DoubleChain* chain, int* index_out,
+                                   vigor_time_t time, int* budget);
+
+#endif//_DOUBLE_CHAIN_EXT_H_INCLUDED_
@@ -0,0 +1,220 @@
+// Unverified alternative to libvig/verified/double-chain.c, selected with
+// VIGOR_DCHAIN=lazy.
+// Rejuvenating an index only stamps the time, so that the indexes of busy flows
+// do not rewrite the allocation list, and their neighbours in it, on every
+// packet. Instead, expiring gives indexes a second chance: if the oldest index
+// in the list was rejuvenated since it was queued at its end, it is queued at
+// the end again, and expiring goes on with the next one.
+// The list stays ordered by the time indexes were queued, which is at most
+// their last rejuvenation, so expiring is exact: it can stop at the first index
+// queued after the expiration time. The only exception is an index queued again
+// behind indexes allocated or queued after its last rejuvenation; such "late"
+// indexes are also kept in a min-heap by rejuvenation time, which expiring
+// checks first, until they are rejuvenated again or freed.
+// Rejuvenating can also skip writing the time if it was written less than
+// VIGOR_DCHAIN_GRANULARITY ago: stamps are then that much ahead of the time
+// that wrote them, so that skipping a write only delays expiry, by at most
+// the granularity. A granularity of 0 is exact.
+// Each expiration moves at most VIGOR_DCHAIN_REQUEUE_BUDGET indexes before it
+// gives up until the next one, so that many indexes reaching their expiration
+// time at once, e.g. flows allocated in a single burst that all stay alive,
+// do not stall a single expiration; expired indexes behind them are then
+// expired by the following calls.
+
+#include "libvig/verified/double-chain.h"
+#include "libvig/unverified/double-chain-ext.h"
+
+#include <stdlib.h>
+
+#include "libvig/verified/double-chain-impl.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "libvig/unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
+
+// In vigor_time_t units, i.e. nanoseconds
+#ifndef VIGOR_DCHAIN_GRANULARITY
+#  define VIGOR_DCHAIN_GRANULARITY 0
+#endif
+
+#ifndef VIGOR_DCHAIN_REQUEUE_BUDGET
+#  define VIGOR_DCHAIN_REQUEUE_BUDGET 64
+#endif
+
+// An index queued behind indexes queued after its last rejuvenation
+struct dchain_late {
+  vigor_time_t time; // last rejuvenation when it was queued
+  int index;
+};
+
+struct DoubleChain {
+  struct dchain_cell* cells;
+  char* stamps;
+  unsigned stride; // between the stamps of consecutive indexes
+  vigor_time_t last_queued; // when the index at the end of the list was queued
+  struct dchain_late* lates; // min-heap by time, at most one per index
+  unsigned late_count;
+};
+
+static inline struct dchain_stamps* index_stamps(struct DoubleChain* chain,
+                                                 int index) {
+  return (struct dchain_stamps*)(chain->stamps + (size_t)index * chain->stride);
+}
+
+static void late_push(struct DoubleChain* chain, int index, vigor_time_t time) {
+  unsigned n = chain->late_count;
+  chain->late_count++;
+  while (n != 0 && chain->lates[(n - 1) / 2].time > time) {
+    chain->lates[n] = chain->lates[(n - 1) / 2];
+    n = (n - 1) / 2;
+  }
+  chain->lates[n].time = time;
+  chain->lates[n].index = index;
+}
+
+static struct dchain_late late_pop(struct DoubleChain* chain) {
+  struct dchain_late top = chain->lates[0];
+  chain->late_count--;
+  struct dchain_late last = chain->lates[chain->late_count];
+  unsigned n = 0;
+  for (;;) {
+    unsigned child = 2 * n + 1;
+    if (child >= chain->late_count) {
+      break;
+    }
+    if (child + 1 < chain->late_count &&
+        chain->lates[child + 1].time < chain->lates[child].time) {
+      child++;
+    }
+    if (last.time <= chain->lates[child].time) {
+      break;
+    }
+    chain->lates[n] = chain->lates[child];
+    n = child;
+  }
+  chain->lates[n] = last;
+  return top;
+}
+
+int dchain_allocate_in(int index_range, void* first_stamps, unsigned stride,
+                       struct DoubleChain** chain_out) {
+  struct DoubleChain* chain =
+      (struct DoubleChain*)malloc(sizeof(struct DoubleChain));
+  if (chain == NULL) {
+    return 0;
+  }
+  chain->cells = (struct dchain_cell*)malloc(
+      sizeof(struct dchain_cell) * (index_range + DCHAIN_RESERVED));
+  if (chain->cells == NULL) {
+    free(chain);
+    return 0;
+  }
+  chain->lates =
+      (struct dchain_late*)malloc(sizeof(struct dchain_late) * index_range);
+  if (chain->lates == NULL) {
+    free(chain->cells);
+    free(chain);
+    return 0;
+  }
+  chain->stamps = (char*)first_stamps;
+  chain->stride = stride;
+  chain->last_queued = 0;
+  chain->late_count = 0;
+  dchain_impl_init(chain->cells, index_range);
+  *chain_out = chain;
+  return 1;
+}
+
+int dchain_allocate(int index_range, struct DoubleChain** chain_out) {
+  void* stamps = malloc(sizeof(struct dchain_stamps) * index_range);
+  if (stamps == NULL) {
+    return 0;
+  }
+  if (!dchain_allocate_in(index_range, stamps, sizeof(struct dchain_stamps),
+                          chain_out)) {
+    free(stamps);
+    return 0;
+  }
+  return 1;
+}
+
+int dchain_allocate_new_index(struct DoubleChain* chain, int* index_out,
+                              vigor_time_t time) {
+  int ret = dchain_impl_allocate_new_index(chain->cells, index_out);
+  if (ret) {
+    struct dchain_stamps* stamps = index_stamps(chain, *index_out);
+    stamps->time = time + VIGOR_DCHAIN_GRANULARITY;
+    stamps->queued = stamps->time;
+    chain->last_queued = stamps->time;
+  }
+  return ret;
+}
+
+int dchain_rejuvenate_index(struct DoubleChain* chain, int index,
+                            vigor_time_t time) {
+  if (!dchain_impl_is_index_allocated(chain->cells, index)) {
+    return 0;
+  }
+  struct dchain_stamps* stamps = index_stamps(chain, index);
+  // Unless the stamp is still ahead, see VIGOR_DCHAIN_GRANULARITY
+  if (stamps->time < time) {
+    stamps->time = time + VIGOR_DCHAIN_GRANULARITY;
+  }
+  return 1;
+}
+
+int dchain_expire_one_index_budget(struct DoubleChain* chain, int* index_out,
+                                   vigor_time_t time, int* budget) {
+  for (; *budget > 0; --*budget) {
+    if (chain->late_count != 0 && chain->lates[0].time < time) {
+      struct dchain_late late = late_pop(chain);
+      // Unless it was freed or rejuvenated since, in which case its time is
+      // later than when it was queued
+      if (dchain_impl_is_index_allocated(chain->cells, late.index) &&
+          index_stamps(chain, late.index)->time == late.time) {
+        *index_out = late.index;
+        --*budget;
+        return dchain_impl_free_index(chain->cells, late.index);
+      }
+      continue;
+    }
+
+    if (!dchain_impl_get_oldest_index(chain->cells, index_out)) {
+      return 0;
+    }
+    struct dchain_stamps* stamps = index_stamps(chain, *index_out);
+    if (stamps->time < time) {
+      --*budget;
+      return dchain_impl_free_index(chain->cells, *index_out);
+    }
+    if (stamps->queued >= time) {
+      // The indexes after it were queued later, and rejuvenated since unless
+      // they are late
+      return 0;
+    }
+
+    // Rejuvenated since it was queued, give it a second chance
+    dchain_impl_rejuvenate_index(chain->cells, *index_out);
+    if (stamps->time < chain->last_queued) {
+      stamps->queued = chain->last_queued;
+      late_push(chain, *index_out, stamps->time);
+    } else {
+      stamps->queued = stamps->time;
+      chain->last_queued = stamps->time;
+    }
+  }
+  return 0;
+}
+
+int dchain_expire_one_index(struct DoubleChain* chain, int* index_out,
+                            vigor_time_t time) {
+  int budget = VIGOR_DCHAIN_REQUEUE_BUDGET;
+  return dchain_expire_one_index_budget(chain, index_out, time, &budget);
+}
+
+int dchain_is_index_allocated(struct DoubleChain* chain, int index) {
+  return dchain_impl_is_index_allocated(chain->cells, index);
+}
+
+int dchain_free_index(struct DoubleChain* chain, int index) {
+  return dchain_impl_free_index(chain->cells, index);
+}
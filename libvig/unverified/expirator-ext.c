@@ -0,0 +1,24 @@
+#include "expirator-ext.h"
+#ifdef VIGOR_DCHAIN
+#  include "libvig/unverified/double-chain-ext.h"
+#endif//VIGOR_DCHAIN
+
+int expire_items_single_map_budget(struct DoubleChain* chain,
+                                   struct Vector* vector, struct Map* map,
+                                   vigor_time_t time, int budget) {
+  int count = 0;
+  int index = -1;
+#ifdef VIGOR_DCHAIN
+  // Moving indexes in the lazy double chain counts too
+  while (dchain_expire_one_index_budget(chain, &index, time, &budget)) {
+#else//VIGOR_DCHAIN
+  while (count < budget && dchain_expire_one_index(chain, &index, time)) {
+#endif//VIGOR_DCHAIN
+    void* key;
+    vector_borrow(vector, index, &key);
+    map_erase(map, key, &key);
+    vector_return(vector, index, key);
+    ++count;
+  }
+  return count;
+}
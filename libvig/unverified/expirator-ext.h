@@ -0,0 +1,16 @@
+#ifndef _EXPIRATOR_EXT_H_INCLUDED_
+#define _EXPIRATOR_EXT_H_INCLUDED_
+
+#include "libvig/verified/expirator.h"
+
+// Unverified extensions to the expirator, see map-ext.h.
+
+//   Same as expire_items_single_map, but expires at most budget items, so
+//   that the time it takes is bounded; items older than time may remain.
+//   With VIGOR_DCHAIN=lazy, the indexes that the chain moves count too.
+//   @returns the number of expired items.
+int expire_items_single_map_budget(struct DoubleChain* chain,
+                                   struct Vector* vector, struct Map* map,
+                                   vigor_time_t time, int budget);
+
+#endif//_EXPIRATOR_EXT_H_INCLUDED_
@@ -0,0 +1,166 @@
+#include "map-ext.h"
+
+#include <assert.h>
+
+#include "libvig/verified/map-struct.h"
+#ifdef CAPACITY_POW2
+#  include "libvig/verified/map-impl-pow2.h"
+#else//CAPACITY_POW2
+#  include "libvig/verified/map-impl.h"
+#endif//CAPACITY_POW2
+
+// Same probing as in the verified implementation (map-impl-pow2.c / map-impl.c),
+// which these functions must stay consistent with.
+
+static unsigned loop(unsigned k, unsigned capacity) {
+#ifdef CAPACITY_POW2
+  return k & (capacity - 1);
+#else
+  return k % capacity;
+#endif
+}
+
+static int find_key(struct Map* map, void* keyp, unsigned key_hash) {
+  unsigned start = loop(key_hash, map->capacity);
+  for (unsigned i = 0; i < map->capacity; ++i) {
+    unsigned index = loop(start + i, map->capacity);
+    if (map->busybits[index] != 0 && map->khs[index] == key_hash) {
+      if (map->keys_eq(map->keyps[index], keyp)) {
+        return (int)index;
+      }
+    } else if (map->chns[index] == 0) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+int map_allocate_sized(map_keys_equality* keq, map_key_hash* khash,
+                       unsigned key_size, unsigned capacity,
+                       struct Map** map_out) {
+  // Keys stay outside of this map
+  (void)key_size;
+  return map_allocate(keq, khash, capacity, map_out);
+}
+
+int map_get_hashed(struct Map* map, void* key, unsigned hash, int* value_out) {
+  return map_impl_get(map->busybits, map->keyps, map->khs, map->chns,
+                      map->vals, key, map->keys_eq, hash, value_out,
+                      map->capacity);
+}
+
+void map_put_hashed(struct Map* map, void* key, unsigned hash, int value) {
+  map_impl_put(map->busybits, map->keyps, map->khs, map->chns, map->vals,
+               key, hash, value, map->capacity);
+  ++map->size;
+}
+
+void map_erase_hashed(struct Map* map, void* key, unsigned hash,
+                      void** trash) {
+  map_impl_erase(map->busybits, map->keyps, map->khs, map->chns, key,
+                 map->keys_eq, hash, map->capacity, trash);
+  --map->size;
+}
+
+int map_get_or_reserve_hashed(struct Map* map, void* key, unsigned hash,
+                              int* value_out,
+                              struct MapReservation* reservation) {
+  unsigned start = loop(hash, map->capacity);
+  reservation->hash = hash;
+  reservation->index = -1;
+
+  // Same as find_key, also noting the first free slot, which is where
+  // map_impl_put would put the key
+  unsigned i = 0;
+  for (; i < map->capacity; ++i) {
+    unsigned index = loop(start + i, map->capacity);
+    if (map->busybits[index] == 0 && reservation->index == -1) {
+      reservation->index = (int)index;
+      reservation->distance = i;
+    }
+    if (map->busybits[index] != 0 && map->khs[index] == hash) {
+      if (map->keys_eq(map->keyps[index], key)) {
+        *value_out = map->vals[index];
+        return 1;
+      }
+    } else if (map->chns[index] == 0) {
+      break;
+    }
+  }
+
+  // The free slot may be past the end of the chain
+  for (; reservation->index == -1 && i < map->capacity; ++i) {
+    unsigned index = loop(start + i, map->capacity);
+    if (map->busybits[index] == 0) {
+      reservation->index = (int)index;
+      reservation->distance = i;
+    }
+  }
+  return 0;
+}
+
+int map_get_or_reserve(struct Map* map, void* key, int* value_out,
+                       struct MapReservation* reservation) {
+  return map_get_or_reserve_hashed(map, key, map->khash(key), value_out,
+                                   reservation);
+}
+
+void map_commit(struct Map* map, struct MapReservation* reservation,
+                void* key, int value) {
+  assert(reservation->index != -1);
+  // Same chain counting as map_impl_put, which went through all busy slots
+  // between the start of the chain and the free one
+  unsigned start = loop(reservation->hash, map->capacity);
+  for (unsigned i = 0; i < reservation->distance; ++i) {
+    map->chns[loop(start + i, map->capacity)]++;
+  }
+  unsigned index = (unsigned)reservation->index;
+  map->busybits[index] = 1;
+  map->keyps[index] = key;
+  map->khs[index] = reservation->hash;
+  map->vals[index] = value;
+  ++map->size;
+}
+
+void map_prefetch_hashed(struct Map* map, unsigned hash) {
+  // The metadata of the home slot
+  unsigned index = loop(hash, map->capacity);
+  __builtin_prefetch(&map->busybits[index]);
+  __builtin_prefetch(&map->khs[index]);
+  __builtin_prefetch(&map->chns[index]);
+  __builtin_prefetch(&map->keyps[index]);
+  __builtin_prefetch(&map->vals[index]);
+}
+
+int map_get_bulk(struct Map* map, void** keys, unsigned count,
+                 int* values_out, uint64_t* found_mask) {
+  assert(count <= MAP_BULK_MAX);
+
+  // First, hash all keys and prefetch the metadata of their home slots...
+  unsigned hashes[MAP_BULK_MAX];
+  for (unsigned n = 0; n < count; n++) {
+    hashes[n] = map->khash(keys[n]);
+    map_prefetch_hashed(map, hashes[n]);
+  }
+
+  // ...then prefetch the stored keys that may match...
+  for (unsigned n = 0; n < count; n++) {
+    unsigned index = loop(hashes[n], map->capacity);
+    if (map->busybits[index] != 0 && map->khs[index] == hashes[n]) {
+      __builtin_prefetch(map->keyps[index]);
+    }
+  }
+
+  // ...and finally compare, which usually stops at the home slot
+  int found = 0;
+  *found_mask = 0;
+  for (unsigned n = 0; n < count; n++) {
+    int index = find_key(map, keys[n], hashes[n]);
+    if (index != -1) {
+      values_out[n] = map->vals[index];
+      *found_mask |= UINT64_C(1) << n;
+      found++;
+    }
+  }
+  return found;
+}
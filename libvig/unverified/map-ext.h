@@ -0,0 +1,113 @@
+#ifndef _MAP_EXT_H_INCLUDED_
+#define _MAP_EXT_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "libvig/verified/map.h"
+
+// Unverified extensions to the Map API, for the unverified fast paths such as
+// batching; they must not be used in code that is verified.
+// They are implemented for the verified map in map-ext.c, and by each of the
+// alternative map implementations in map/.
+
+//   Allocate a map whose keys all have the given size, so that
+//   implementations that copy keys into the map know how much to copy.
+//   Otherwise the same as map_allocate.
+int map_allocate_sized(map_keys_equality* keq, map_key_hash* khash,
+                       unsigned key_size, unsigned capacity,
+                       struct Map** map_out);
+
+//   The same as map_get, map_put and map_erase, with the hash of the key
+//   already computed, for callers that use the same key several times.
+int map_get_hashed(struct Map* map, void* key, unsigned hash, int* value_out);
+void map_put_hashed(struct Map* map, void* key, unsigned hash, int value);
+void map_erase_hashed(struct Map* map, void* key, unsigned hash,
+                      void** trash);
+
+// Where map_commit puts a key that map_get_or_reserve did not find; the
+// meaning of index and distance depends on the implementation.
+struct MapReservation {
+  unsigned hash;
+  int index;
+  unsigned distance;
+};
+
+//   Look up a key like map_get, and if it is not found, also remember where
+//   map_put would put it, so that map_commit can put it there without hashing
+//   and probing again.
+//   @param map - the map.
+//   @param key - the key to look up.
+//   @param value_out - set to the value of the key if found.
+//   @param reservation - set to where the key goes if not found.
+//   @returns 1 if the key is found, 0 otherwise.
+int map_get_or_reserve(struct Map* map, void* key, int* value_out,
+                       struct MapReservation* reservation);
+
+//   The same, with the hash of the key already computed, which must be the
+//   same as the one the hash function of the map computes.
+int map_get_or_reserve_hashed(struct Map* map, void* key, unsigned hash,
+                              int* value_out,
+                              struct MapReservation* reservation);
+
+//   Put a key at the place reserved by map_get_or_reserve, which is only valid
+//   until the map is modified; as for map_put, the map must not be full.
+//   @param map - the map.
+//   @param reservation - the reservation for this key.
+//   @param key - a key equal to the one given to map_get_or_reserve, whose
+//                storage is owned by the caller as with map_put.
+//   @param value - the value.
+void map_commit(struct Map* map, struct MapReservation* reservation,
+                void* key, int value);
+
+//   Prefetch the slots where a key with the given hash is looked up first, so
+//   that looking it up later, e.g. with map_get_hashed, does not wait for
+//   memory; the hash must be the same as the one the map computes.
+void map_prefetch_hashed(struct Map* map, unsigned hash);
+
+// Maximum number of keys in a single bulk operation, one per bit of a mask.
+#define MAP_BULK_MAX 64
+
+//   Look up several keys at once. All keys are hashed and their slots are
+//   prefetched before any of them is compared, so that their cache misses
+//   overlap instead of being serialized as with successive map_get calls.
+//   @param map - the map.
+//   @param keys - the keys to look up.
+//   @param count - the number of keys, at most MAP_BULK_MAX.
+//   @param values_out - values_out[n] is set to the value of keys[n] if found.
+//   @param found_mask - output bitmask, whose bit n is set if keys[n] is found.
+//   @returns the number of keys found.
+int map_get_bulk(struct Map* map, void** keys, unsigned count,
+                 int* values_out, uint64_t* found_mask);
+
+// The smallest power of 2 that is at least n, for the alternative map
+// implementations to size their tables; a constant expression if n is one.
+#define MAP_POW2_CEIL(n)                                                       \
+  ((uint64_t)(n) <= 1                                                          \
+       ? UINT64_C(1)                                                           \
+       : UINT64_C(2) << (63 - __builtin_clzll((uint64_t)(n) - 1)))
+
+// Map functions specialized for maps whose keys are of type struct type, named
+// e.g. map_FlowId_get, which codegen generates along with the equality and
+// hash functions of each struct when VIGOR_MAP is defined, see map-typed.h.
+// They behave as their generic counterparts of the same name.
+#define MAP_TYPED_DECLARATIONS(type)                                           \
+  int map_##type##_get(struct Map* map, struct type* key, int* value_out);     \
+  int map_##type##_get_hashed(struct Map* map, struct type* key,               \
+                              unsigned hash, int* value_out);                  \
+  void map_##type##_put(struct Map* map, struct type* key, int value);         \
+  void map_##type##_put_hashed(struct Map* map, struct type* key,              \
+                               unsigned hash, int value);                      \
+  void map_##type##_erase(struct Map* map, struct type* key, void** trash);    \
+  void map_##type##_erase_hashed(struct Map* map, struct type* key,            \
+                                 unsigned hash, void** trash);                 \
+  int map_##type##_get_or_reserve(struct Map* map, struct type* key,           \
+                                  int* value_out,                              \
+                                  struct MapReservation* reservation);         \
+  int map_##type##_get_or_reserve_hashed(struct Map* map, struct type* key,    \
+                                         unsigned hash, int* value_out,        \
+                                         struct MapReservation* reservation);  \
+  void map_##type##_commit(struct Map* map,                                    \
+                           struct MapReservation* reservation,                 \
+                           struct type* key, int value);
+
+#endif//_MAP_EXT_H_INCLUDED_
@@ -0,0 +1,82 @@
+#ifndef _MAP_TYPED_H_INCLUDED_
+#define _MAP_TYPED_H_INCLUDED_
+
+// Definitions of the map functions that MAP_TYPED_DECLARATIONS in map-ext.h
+// declares, for the unverified alternative map implementations only.
+// They instantiate the probing functions of the implementation, from the
+// header that VIGOR_MAP_HEADER names, with the equality and hash functions of
+// the key type and its size, so that the compiler can inline the former and
+// copy keys without a variable-size memcpy; the generic functions call the
+// same probing functions through the pointers stored in the map.
+// Codegen puts MAP_TYPED_FUNCTIONS(type) in the same file as the equality and
+// hash functions of type, so that they can be inlined. The maps they are used
+// on must have been allocated with map_allocate_sized and the size of
+// struct type, as state.c does with VIGOR_MAP. If all those maps have a
+// capacity fixed at build time, codegen uses MAP_TYPED_FUNCTIONS_FIXED
+// instead, and alloc_state checks that they are allocated with it.
+
+#include "libvig/unverified/map-ext.h"
+#include VIGOR_MAP_HEADER
+
+#define MAP_TYPED_KEY_SIZE(type)                                               \
+  (sizeof(struct type) <= MAP_INLINE_KEY_SIZE ? (unsigned)sizeof(struct type)  \
+                                              : 0)
+
+// The functions, with the given expression of map as the mask of the map, see
+// MAP_CAPACITY_MASK in the header of the implementation
+#define MAP_TYPED_FUNCTIONS_MASKED(type, mask)                                 \
+  int map_##type##_get_hashed(struct Map* map, struct type* key,               \
+                              unsigned hash, int* value_out) {                 \
+    return map_typed_get(map, type##_eq, MAP_TYPED_KEY_SIZE(type), (mask),     \
+                         key, hash, value_out);                                \
+  }                                                                            \
+  int map_##type##_get(struct Map* map, struct type* key, int* value_out) {    \
+    return map_##type##_get_hashed(map, key, type##_hash(key), value_out);     \
+  }                                                                            \
+  void map_##type##_put_hashed(struct Map* map, struct type* key,              \
+                               unsigned hash, int value) {                     \
+    map_typed_put(map, MAP_TYPED_KEY_SIZE(type), (mask), key, hash, value);    \
+  }                                                                            \
+  void map_##type##_put(struct Map* map, struct type* key, int value) {        \
+    map_##type##_put_hashed(map, key, type##_hash(key), value);                \
+  }                                                                            \
+  void map_##type##_erase_hashed(struct Map* map, struct type* key,            \
+                                 unsigned hash, void** trash) {                \
+    map_typed_erase(map, type##_eq, MAP_TYPED_KEY_SIZE(type), (mask), key,     \
+                    hash, trash);                                              \
+  }                                                                            \
+  void map_##type##_erase(struct Map* map, struct type* key, void** trash) {   \
+    map_##type##_erase_hashed(map, key, type##_hash(key), trash);              \
+  }                                                                            \
+  int map_##type##_get_or_reserve_hashed(struct Map* map, struct type* key,    \
+                                         unsigned hash, int* value_out,        \
+                                         struct MapReservation* reservation) { \
+    return map_typed_get_or_reserve(map, type##_eq, MAP_TYPED_KEY_SIZE(type),  \
+                                    (mask), key, hash, value_out,              \
+                                    reservation);                              \
+  }                                                                            \
+  int map_##type##_get_or_reserve(struct Map* map, struct type* key,           \
+                                  int* value_out,                              \
+                                  struct MapReservation* reservation) {        \
+    return map_##type##_get_or_reserve_hashed(map, key, type##_hash(key),      \
+                                              value_out, reservation);         \
+  }                                                                            \
+  void map_##type##_commit(struct Map* map,                                    \
+                           struct MapReservation* reservation,                 \
+                           struct type* key, int value) {                      \
+    map_typed_commit(map, MAP_TYPED_KEY_SIZE(type), (mask), reservation, key,  \
+                     value);                                                   \
+  }
+
+// The mask of the map, from the map itself
+#define MAP_TYPED_FUNCTIONS(type)                                              \
+  MAP_TYPED_FUNCTIONS_MASKED(type, map_mask(map))
+
+// The same, for maps that all have the given capacity, fixed at build time,
+// e.g. with VIGOR_FIXED_<PARAM>: the mask is then a constant, as are the
+// bounds of probing loops, which saves a load and lets the compiler fold the
+// mask into the address computations.
+#define MAP_TYPED_FUNCTIONS_FIXED(type, capacity)                              \
+  MAP_TYPED_FUNCTIONS_MASKED(type, MAP_CAPACITY_MASK(capacity))
+
+#endif//_MAP_TYPED_H_INCLUDED_
@@ -0,0 +1,140 @@
+// Unverified alternative to libvig/verified/map.c, selected with VIGOR_MAP=bucketed.
+// Slots are grouped in cache-line-sized buckets that hold the key hashes,
+// the values and copies of the keys, so a lookup that finds its key in its home
+// bucket touches a single cache line.
+// Probing is the same as in the verified map, one bucket at a time instead of
+// one slot at a time: the chain counter of a bucket counts the keys that had to
+// be placed further because the bucket was full.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvig/unverified/map/bucketed.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "libvig/unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
+
+int map_allocate_sized(map_keys_equality* keq, map_key_hash* khash,
+                       unsigned key_size, unsigned capacity,
+                       struct Map** map_out) {
+  if (capacity == 0) {
+    return 0;
+  }
+  unsigned bucket_count = MAP_CAPACITY_MASK(capacity) + 1;
+
+  struct Map* map = (struct Map*)malloc(sizeof(struct Map));
+  if (map == NULL) {
+    return 0;
+  }
+  map->buckets = (struct MapBucket*)aligned_alloc(
+      sizeof(struct MapBucket), sizeof(struct MapBucket) * bucket_count);
+  if (map->buckets == NULL) {
+    free(map);
+    return 0;
+  }
+  memset(map->buckets, 0, sizeof(struct MapBucket) * bucket_count);
+  map->keyps = NULL;
+  map->key_size = key_size <= MAP_INLINE_KEY_SIZE ? key_size : 0;
+  if (map->key_size == 0) {
+    map->keyps = (void**)malloc(sizeof(void*) * bucket_count * MAP_BUCKET_SLOTS);
+    if (map->keyps == NULL) {
+      free(map->buckets);
+      free(map);
+      return 0;
+    }
+  }
+  map->bucket_mask = bucket_count - 1;
+  map->capacity = capacity;
+  map->size = 0;
+  map->keys_eq = keq;
+  map->khash = khash;
+  *map_out = map;
+  return 1;
+}
+
+int map_allocate(map_keys_equality* keq, map_key_hash* khash,
+                 unsigned capacity, struct Map** map_out) {
+  return map_allocate_sized(keq, khash, 0, capacity, map_out);
+}
+
+int map_get_hashed(struct Map* map, void* key, unsigned hash, int* value_out) {
+  return map_typed_get(map, map->keys_eq, map->key_size, map->bucket_mask, key,
+                       hash, value_out);
+}
+
+int map_get(struct Map* map, void* key, int* value_out) {
+  return map_get_hashed(map, key, map->khash(key), value_out);
+}
+
+void map_put_hashed(struct Map* map, void* key, unsigned hash, int value) {
+  map_typed_put(map, map->key_size, map->bucket_mask, key, hash, value);
+}
+
+void map_put(struct Map* map, void* key, int value) {
+  map_put_hashed(map, key, map->khash(key), value);
+}
+
+void map_erase_hashed(struct Map* map, void* key, unsigned hash,
+                      void** trash) {
+  map_typed_erase(map, map->keys_eq, map->key_size, map->bucket_mask, key,
+                  hash, trash);
+}
+
+void map_erase(struct Map* map, void* key, void** trash) {
+  map_erase_hashed(map, key, map->khash(key), trash);
+}
+
+int map_get_or_reserve_hashed(struct Map* map, void* key, unsigned hash,
+                              int* value_out,
+                              struct MapReservation* reservation) {
+  return map_typed_get_or_reserve(map, map->keys_eq, map->key_size,
+                                  map->bucket_mask, key, hash, value_out,
+                                  reservation);
+}
+
+int map_get_or_reserve(struct Map* map, void* key, int* value_out,
+                       struct MapReservation* reservation) {
+  return map_get_or_reserve_hashed(map, key, map->khash(key), value_out,
+                                   reservation);
+}
+
+void map_commit(struct Map* map, struct MapReservation* reservation,
+                void* key, int value) {
+  map_typed_commit(map, map->key_size, map->bucket_mask, reservation, key,
+                   value);
+}
+
+unsigned map_size(struct Map* map) {
+  return map->size;
+}
+
+void map_prefetch_hashed(struct Map* map, unsigned hash) {
+  unsigned b = hash & map->bucket_mask;
+  __builtin_prefetch(&map->buckets[b]);
+  if (map->key_size == 0) {
+    __builtin_prefetch(&map->keyps[b * MAP_BUCKET_SLOTS]);
+  }
+}
+
+int map_get_bulk(struct Map* map, void** keys, unsigned count,
+                 int* values_out, uint64_t* found_mask) {
+  // Home buckets are a single cache line, so one round of prefetches suffices
+  // unless the keys are stored outside.
+  unsigned hashes[MAP_BULK_MAX];
+  for (unsigned n = 0; n < count; n++) {
+    hashes[n] = map->khash(keys[n]);
+    map_prefetch_hashed(map, hashes[n]);
+  }
+
+  int found = 0;
+  *found_mask = 0;
+  for (unsigned n = 0; n < count; n++) {
+    if (map_typed_get(map, map->keys_eq, map->key_size, map->bucket_mask,
+                      keys[n], hashes[n], &values_out[n])) {
+      *found_mask |= UINT64_C(1) << n;
+      found++;
+    }
+  }
+  return found;
+}
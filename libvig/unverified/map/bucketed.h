@@ -0,0 +1,202 @@
+#ifndef _MAP_BUCKETED_H_INCLUDED_
+#define _MAP_BUCKETED_H_INCLUDED_
+
+// Layout and probing of the bucketed map, see bucketed.c.
+// The probing functions take the key equality, the size of inline keys and
+// the bucket mask as parameters instead of reading them from the map, so that
+// map-typed.h can instantiate them for a key type, with the first two known at
+// compile time, and the last one too for a capacity fixed at build time.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libvig/verified/map.h"
+#include "libvig/unverified/map-ext.h"
+
+// Keys up to this size are copied into the map, larger ones are kept by pointer
+#ifndef MAP_INLINE_KEY_SIZE
+#  define MAP_INLINE_KEY_SIZE 16
+#endif
+#define MAP_BUCKET_SLOTS 2
+#define MAP_BUCKET_FULL ((1 << MAP_BUCKET_SLOTS) - 1)
+
+struct MapBucket {
+  unsigned khs[MAP_BUCKET_SLOTS];
+  int vals[MAP_BUCKET_SLOTS];
+  unsigned chn;
+  uint8_t busy; // bitmask of the occupied slots
+  uint8_t keys[MAP_BUCKET_SLOTS][MAP_INLINE_KEY_SIZE];
+} __attribute__((aligned(64)));
+
+struct Map {
+  struct MapBucket* buckets;
+  void** keyps; // only if the keys are not inline
+  unsigned bucket_mask;
+  unsigned key_size; // 0 if the keys are not inline
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+// The bucket mask of a map of the given capacity, which has a power of 2 of
+// buckets such that it is at most 80% full, since like probe distances, chains
+// grow quickly with the load; a constant expression if the capacity is one
+#define MAP_CAPACITY_MASK(capacity)                                            \
+  ((unsigned)MAP_POW2_CEIL(((uint64_t)(capacity) + (capacity) / 4 +            \
+                            MAP_BUCKET_SLOTS - 1) / MAP_BUCKET_SLOTS) - 1)
+
+static inline unsigned map_mask(struct Map* map) {
+  return map->bucket_mask;
+}
+
+static inline __attribute__((always_inline)) void*
+map_slot_key(struct Map* map, unsigned key_size, unsigned bucket,
+             unsigned slot) {
+  if (key_size == 0) {
+    return map->keyps[bucket * MAP_BUCKET_SLOTS + slot];
+  }
+  return map->buckets[bucket].keys[slot];
+}
+
+static inline __attribute__((always_inline)) int
+map_find_slot(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+              unsigned bucket_mask, void* keyp, unsigned key_hash,
+              unsigned* bucket_out, unsigned* slot_out) {
+  unsigned b = key_hash & bucket_mask;
+  for (unsigned i = 0; i <= bucket_mask; ++i) {
+    struct MapBucket* bucket = &map->buckets[b];
+    for (unsigned s = 0; s < MAP_BUCKET_SLOTS; ++s) {
+      if ((bucket->busy & (1 << s)) != 0 && bucket->khs[s] == key_hash &&
+          keys_eq(map_slot_key(map, key_size, b, s), keyp)) {
+        *bucket_out = b;
+        *slot_out = s;
+        return 1;
+      }
+    }
+    if (bucket->chn == 0) {
+      return 0;
+    }
+    b = (b + 1) & bucket_mask;
+  }
+  return 0;
+}
+
+static inline __attribute__((always_inline)) void
+map_put_slot(struct Map* map, unsigned key_size, unsigned b, void* key,
+             unsigned key_hash, int value) {
+  struct MapBucket* bucket = &map->buckets[b];
+  unsigned s = __builtin_ctz(~bucket->busy);
+  bucket->busy |= 1 << s;
+  bucket->khs[s] = key_hash;
+  bucket->vals[s] = value;
+  if (key_size == 0) {
+    map->keyps[b * MAP_BUCKET_SLOTS + s] = key;
+  } else {
+    memcpy(bucket->keys[s], key, key_size);
+  }
+  map->size++;
+}
+
+static inline __attribute__((always_inline)) int
+map_typed_get(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+              unsigned bucket_mask, void* key, unsigned hash, int* value_out) {
+  unsigned b, s;
+  if (!map_find_slot(map, keys_eq, key_size, bucket_mask, key, hash, &b, &s)) {
+    return 0;
+  }
+  *value_out = map->buckets[b].vals[s];
+  return 1;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_put(struct Map* map, unsigned key_size, unsigned bucket_mask,
+              void* key, unsigned hash, int value) {
+  unsigned b = hash & bucket_mask;
+  // There is a free slot, since the map is not full
+  while (map->buckets[b].busy == MAP_BUCKET_FULL) {
+    map->buckets[b].chn++;
+    b = (b + 1) & bucket_mask;
+  }
+  map_put_slot(map, key_size, b, key, hash, value);
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_erase(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+                unsigned bucket_mask, void* key, unsigned hash, void** trash) {
+  unsigned b = hash & bucket_mask;
+  // The key is in the map
+  for (;;) {
+    struct MapBucket* bucket = &map->buckets[b];
+    for (unsigned s = 0; s < MAP_BUCKET_SLOTS; ++s) {
+      if ((bucket->busy & (1 << s)) != 0 && bucket->khs[s] == hash &&
+          keys_eq(map_slot_key(map, key_size, b, s), key)) {
+        // With inline keys, the map holds no pointer to give back, and the
+        // caller's key is just as good since the key pointers that libVig
+        // hands back only matter for the proofs.
+        *trash = key_size == 0 ? map->keyps[b * MAP_BUCKET_SLOTS + s] : key;
+        bucket->busy &= ~(1 << s);
+        map->size--;
+        return;
+      }
+    }
+    bucket->chn--;
+    b = (b + 1) & bucket_mask;
+  }
+}
+
+// The reservation is the first bucket with a free slot, and how many buckets
+// away from the home bucket it is
+static inline __attribute__((always_inline)) int
+map_typed_get_or_reserve(struct Map* map, map_keys_equality* keys_eq,
+                         unsigned key_size, unsigned bucket_mask, void* key,
+                         unsigned hash, int* value_out,
+                         struct MapReservation* reservation) {
+  unsigned b = hash & bucket_mask;
+  reservation->hash = hash;
+  reservation->index = -1;
+
+  unsigned i = 0;
+  for (; i <= bucket_mask; ++i) {
+    struct MapBucket* bucket = &map->buckets[b];
+    if (bucket->busy != MAP_BUCKET_FULL && reservation->index == -1) {
+      reservation->index = (int)b;
+      reservation->distance = i;
+    }
+    for (unsigned s = 0; s < MAP_BUCKET_SLOTS; ++s) {
+      if ((bucket->busy & (1 << s)) != 0 && bucket->khs[s] == hash &&
+          keys_eq(map_slot_key(map, key_size, b, s), key)) {
+        *value_out = bucket->vals[s];
+        return 1;
+      }
+    }
+    if (bucket->chn == 0) {
+      break;
+    }
+    b = (b + 1) & bucket_mask;
+  }
+
+  // The free slot may be past the end of the chain
+  for (; reservation->index == -1 && i <= bucket_mask; ++i) {
+    if (map->buckets[b].busy != MAP_BUCKET_FULL) {
+      reservation->index = (int)b;
+      reservation->distance = i;
+    }
+    b = (b + 1) & bucket_mask;
+  }
+  return 0;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_commit(struct Map* map, unsigned key_size, unsigned bucket_mask,
+                 struct MapReservation* reservation, void* key, int value) {
+  unsigned b = reservation->hash & bucket_mask;
+  for (unsigned i = 0; i < reservation->distance; ++i) {
+    map->buckets[b].chn++;
+    b = (b + 1) & bucket_mask;
+  }
+  map_put_slot(map, key_size, (unsigned)reservation->index, key,
+               reservation->hash, value);
+}
+
+#endif//_MAP_BUCKETED_H_INCLUDED_
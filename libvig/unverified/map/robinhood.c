@@ -0,0 +1,137 @@
+// Unverified alternative to libvig/verified/map.c, selected with VIGOR_MAP=robinhood.
+// Robin Hood hashing: inserting a key displaces keys that are closer to their
+// home slot than it is to its own, and erasing a key shifts the following keys
+// back by one slot instead of leaving a tombstone. Probe distances thus only
+// depend on the current contents of the map, not on its history, and lookups
+// can stop as soon as they reach a key that is closer to its home slot than
+// the key they are looking for would be.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvig/unverified/map/robinhood.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "libvig/unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
+
+int map_allocate_sized(map_keys_equality* keq, map_key_hash* khash,
+                       unsigned key_size, unsigned capacity,
+                       struct Map** map_out) {
+  if (capacity == 0) {
+    return 0;
+  }
+  unsigned slot_count = MAP_CAPACITY_MASK(capacity) + 1;
+
+  struct Map* map = (struct Map*)calloc(1, sizeof(struct Map));
+  if (map == NULL) {
+    return 0;
+  }
+  map->key_size = key_size <= MAP_INLINE_KEY_SIZE ? key_size : 0;
+  map->slots = (struct MapSlot*)calloc(slot_count, sizeof(struct MapSlot));
+  if (map->key_size == 0) {
+    map->keyps = (void**)malloc(sizeof(void*) * slot_count);
+  } else {
+    map->keys = (uint8_t*)malloc((size_t)map->key_size * slot_count);
+  }
+  if (map->slots == NULL || (map->keyps == NULL && map->keys == NULL)) {
+    free(map->slots);
+    free(map->keyps);
+    free(map->keys);
+    free(map);
+    return 0;
+  }
+  map->slot_mask = slot_count - 1;
+  map->capacity = capacity;
+  map->size = 0;
+  map->keys_eq = keq;
+  map->khash = khash;
+  *map_out = map;
+  return 1;
+}
+
+int map_allocate(map_keys_equality* keq, map_key_hash* khash,
+                 unsigned capacity, struct Map** map_out) {
+  return map_allocate_sized(keq, khash, 0, capacity, map_out);
+}
+
+int map_get_hashed(struct Map* map, void* key, unsigned hash, int* value_out) {
+  return map_typed_get(map, map->keys_eq, map->key_size, map->slot_mask, key,
+                       hash, value_out);
+}
+
+int map_get(struct Map* map, void* key, int* value_out) {
+  return map_get_hashed(map, key, map->khash(key), value_out);
+}
+
+void map_put_hashed(struct Map* map, void* key, unsigned hash, int value) {
+  map_typed_put(map, map->key_size, map->slot_mask, key, hash, value);
+}
+
+void map_put(struct Map* map, void* key, int value) {
+  map_put_hashed(map, key, map->khash(key), value);
+}
+
+void map_erase_hashed(struct Map* map, void* key, unsigned hash,
+                      void** trash) {
+  map_typed_erase(map, map->keys_eq, map->key_size, map->slot_mask, key, hash,
+                  trash);
+}
+
+void map_erase(struct Map* map, void* key, void** trash) {
+  map_erase_hashed(map, key, map->khash(key), trash);
+}
+
+int map_get_or_reserve_hashed(struct Map* map, void* key, unsigned hash,
+                              int* value_out,
+                              struct MapReservation* reservation) {
+  return map_typed_get_or_reserve(map, map->keys_eq, map->key_size,
+                                  map->slot_mask, key, hash, value_out,
+                                  reservation);
+}
+
+int map_get_or_reserve(struct Map* map, void* key, int* value_out,
+                       struct MapReservation* reservation) {
+  return map_get_or_reserve_hashed(map, key, map->khash(key), value_out,
+                                   reservation);
+}
+
+void map_commit(struct Map* map, struct MapReservation* reservation,
+                void* key, int value) {
+  map_typed_commit(map, map->key_size, map->slot_mask, reservation, key,
+                   value);
+}
+
+unsigned map_size(struct Map* map) {
+  return map->size;
+}
+
+void map_prefetch_hashed(struct Map* map, unsigned hash) {
+  unsigned index = hash & map->slot_mask;
+  __builtin_prefetch(&map->slots[index]);
+  __builtin_prefetch(map->key_size == 0
+                         ? (void*)&map->keyps[index]
+                         : map_slot_key(map, map->key_size, index));
+}
+
+int map_get_bulk(struct Map* map, void** keys, unsigned count,
+                 int* values_out, uint64_t* found_mask) {
+  // First, hash all keys and prefetch their home slots...
+  unsigned hashes[MAP_BULK_MAX];
+  for (unsigned n = 0; n < count; n++) {
+    hashes[n] = map->khash(keys[n]);
+    map_prefetch_hashed(map, hashes[n]);
+  }
+
+  // ...then compare
+  int found = 0;
+  *found_mask = 0;
+  for (unsigned n = 0; n < count; n++) {
+    if (map_typed_get(map, map->keys_eq, map->key_size, map->slot_mask,
+                      keys[n], hashes[n], &values_out[n])) {
+      *found_mask |= UINT64_C(1) << n;
+      found++;
+    }
+  }
+  return found;
+}
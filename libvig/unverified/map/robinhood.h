@@ -0,0 +1,210 @@
+#ifndef _MAP_ROBINHOOD_H_INCLUDED_
+#define _MAP_ROBINHOOD_H_INCLUDED_
+
+// Layout and probing of the Robin Hood map, see robinhood.c.
+// The probing functions take the key equality, the size of inline keys and
+// the slot mask as parameters instead of reading them from the map, so that
+// map-typed.h can instantiate them for a key type, with the first two known at
+// compile time, and the last one too for a capacity fixed at build time.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libvig/verified/map.h"
+#include "libvig/unverified/map-ext.h"
+
+// Keys up to this size are copied into the map, larger ones are kept by pointer
+#ifndef MAP_INLINE_KEY_SIZE
+#  define MAP_INLINE_KEY_SIZE 16
+#endif
+
+struct MapSlot {
+  unsigned kh;
+  unsigned dist; // 1 + distance from the home slot, 0 if the slot is empty
+  int val;
+};
+
+struct Map {
+  struct MapSlot* slots;
+  uint8_t* keys; // if the keys are inline
+  void** keyps;  // if the keys are not inline
+  unsigned slot_mask;
+  unsigned key_size; // 0 if the keys are not inline
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+// The slot mask of a map of the given capacity, which has a power of 2 of
+// slots such that it is at most 80% full, since probe distances grow quickly
+// with the load, e.g. the longest one is in the hundreds of slots for a full
+// map; a constant expression if the capacity is one
+#define MAP_CAPACITY_MASK(capacity)                                            \
+  ((unsigned)MAP_POW2_CEIL((uint64_t)(capacity) + (capacity) / 4) - 1)
+
+static inline unsigned map_mask(struct Map* map) {
+  return map->slot_mask;
+}
+
+static inline __attribute__((always_inline)) void*
+map_slot_key(struct Map* map, unsigned key_size, unsigned index) {
+  if (key_size == 0) {
+    return map->keyps[index];
+  }
+  return &map->keys[index * key_size];
+}
+
+static inline __attribute__((always_inline)) void
+map_move_slot(struct Map* map, unsigned key_size, unsigned dst, unsigned src) {
+  map->slots[dst] = map->slots[src];
+  if (key_size == 0) {
+    map->keyps[dst] = map->keyps[src];
+  } else {
+    memcpy(&map->keys[dst * key_size], &map->keys[src * key_size], key_size);
+  }
+}
+
+// Returns the index of the given key, or -1 if it is not in the map
+static inline __attribute__((always_inline)) int
+map_find_key(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+             unsigned slot_mask, void* keyp, unsigned key_hash) {
+  unsigned index = key_hash & slot_mask;
+  for (unsigned dist = 1; dist <= slot_mask + 1; ++dist) {
+    struct MapSlot* slot = &map->slots[index];
+    if (slot->dist < dist) {
+      // Empty, or a key closer to its home than ours would be
+      return -1;
+    }
+    if (slot->kh == key_hash &&
+        keys_eq(map_slot_key(map, key_size, index), keyp)) {
+      return (int)index;
+    }
+    index = (index + 1) & slot_mask;
+  }
+  return -1;
+}
+
+// Puts a key whose probe reached the given slot at the given distance
+static inline __attribute__((always_inline)) void
+map_insert_at(struct Map* map, unsigned key_size, unsigned slot_mask,
+              unsigned index, unsigned dist, void* key, unsigned key_hash,
+              int value) {
+  struct MapSlot carried = {
+    .kh = key_hash,
+    .dist = dist,
+    .val = value,
+  };
+  void* carried_keyp = key;
+  uint8_t carried_key[MAP_INLINE_KEY_SIZE];
+  if (key_size != 0) {
+    memcpy(carried_key, key, key_size);
+  }
+
+  // There is an empty slot, since the map is not full
+  while (map->slots[index].dist != 0) {
+    struct MapSlot* slot = &map->slots[index];
+    if (slot->dist < carried.dist) {
+      // Take the place of the richer key, and carry it on
+      struct MapSlot tmp = *slot;
+      *slot = carried;
+      carried = tmp;
+      if (key_size == 0) {
+        void* tmp_keyp = map->keyps[index];
+        map->keyps[index] = carried_keyp;
+        carried_keyp = tmp_keyp;
+      } else {
+        uint8_t tmp_key[MAP_INLINE_KEY_SIZE];
+        uint8_t* slot_keyp = &map->keys[index * key_size];
+        memcpy(tmp_key, slot_keyp, key_size);
+        memcpy(slot_keyp, carried_key, key_size);
+        memcpy(carried_key, tmp_key, key_size);
+      }
+    }
+    carried.dist++;
+    index = (index + 1) & slot_mask;
+  }
+  map->slots[index] = carried;
+  if (key_size == 0) {
+    map->keyps[index] = carried_keyp;
+  } else {
+    memcpy(&map->keys[index * key_size], carried_key, key_size);
+  }
+  map->size++;
+}
+
+static inline __attribute__((always_inline)) int
+map_typed_get(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+              unsigned slot_mask, void* key, unsigned hash, int* value_out) {
+  int index = map_find_key(map, keys_eq, key_size, slot_mask, key, hash);
+  if (index == -1) {
+    return 0;
+  }
+  *value_out = map->slots[index].val;
+  return 1;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_put(struct Map* map, unsigned key_size, unsigned slot_mask,
+              void* key, unsigned hash, int value) {
+  map_insert_at(map, key_size, slot_mask, hash & slot_mask, 1, key, hash,
+                value);
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_erase(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+                unsigned slot_mask, void* key, unsigned hash, void** trash) {
+  int found = map_find_key(map, keys_eq, key_size, slot_mask, key, hash);
+  // The key is in the map
+  unsigned index = (unsigned)found;
+  // With inline keys, the map holds no pointer to give back, and the caller's
+  // key is just as good since the key pointers that libVig hands back only
+  // matter for the proofs.
+  *trash = key_size == 0 ? map->keyps[index] : key;
+
+  // Shift the following keys back, until one that is in its home slot
+  unsigned next = (index + 1) & slot_mask;
+  while (map->slots[next].dist > 1) {
+    map_move_slot(map, key_size, index, next);
+    map->slots[index].dist--;
+    index = next;
+    next = (next + 1) & slot_mask;
+  }
+  map->slots[index].dist = 0;
+  map->size--;
+}
+
+// The reservation is the slot where the lookup stopped, which is also where
+// inserting the key starts to displace others, and the distance there
+static inline __attribute__((always_inline)) int
+map_typed_get_or_reserve(struct Map* map, map_keys_equality* keys_eq,
+                         unsigned key_size, unsigned slot_mask, void* key,
+                         unsigned hash, int* value_out,
+                         struct MapReservation* reservation) {
+  unsigned index = hash & slot_mask;
+  reservation->hash = hash;
+  reservation->index = -1;
+  for (unsigned dist = 1; dist <= slot_mask + 1; ++dist) {
+    struct MapSlot* slot = &map->slots[index];
+    if (slot->dist < dist) {
+      reservation->index = (int)index;
+      reservation->distance = dist;
+      return 0;
+    }
+    if (slot->kh == hash && keys_eq(map_slot_key(map, key_size, index), key)) {
+      *value_out = slot->val;
+      return 1;
+    }
+    index = (index + 1) & slot_mask;
+  }
+  return 0;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_commit(struct Map* map, unsigned key_size, unsigned slot_mask,
+                 struct MapReservation* reservation, void* key, int value) {
+  map_insert_at(map, key_size, slot_mask, (unsigned)reservation->index,
+                reservation->distance, key, reservation->hash, value);
+}
+
+#endif//_MAP_ROBINHOOD_H_INCLUDED_
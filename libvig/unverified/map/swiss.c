@@ -0,0 +1,158 @@
+// Unverified alternative to libvig/verified/map.c, selected with VIGOR_MAP=swiss.
+// Slots are grouped by 16, and each slot has a control byte that is either
+// MAP_CTRL_EMPTY or a 7-bit fingerprint of the hash of its key. A lookup
+// compares the fingerprints of a whole group at once with SIMD instructions,
+// and only compares keys whose fingerprint matches, so long probe sequences at
+// high load factors cost one comparison per group instead of one per slot.
+// Like in the verified map, each group has a chain counter for the keys that
+// had to be placed further because the group was full, which tells lookups
+// when to stop and lets erasing free the slot without tombstones.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvig/unverified/map/swiss.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "libvig/unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
+
+int map_allocate_sized(map_keys_equality* keq, map_key_hash* khash,
+                       unsigned key_size, unsigned capacity,
+                       struct Map** map_out) {
+  if (capacity == 0) {
+    return 0;
+  }
+  unsigned group_count = MAP_CAPACITY_MASK(capacity) + 1;
+  unsigned slot_count = group_count * MAP_GROUP_SLOTS;
+
+  struct Map* map = (struct Map*)calloc(1, sizeof(struct Map));
+  if (map == NULL) {
+    return 0;
+  }
+  map->key_size = key_size <= MAP_INLINE_KEY_SIZE ? key_size : 0;
+  map->groups = (struct MapGroup*)aligned_alloc(
+      sizeof(struct MapGroup), sizeof(struct MapGroup) * group_count);
+  map->chns = (unsigned*)calloc(group_count, sizeof(unsigned));
+  map->vals = (int*)malloc(sizeof(int) * slot_count);
+  if (map->key_size == 0) {
+    map->keyps = (void**)malloc(sizeof(void*) * slot_count);
+  } else {
+    map->keys = (uint8_t*)malloc((size_t)map->key_size * slot_count);
+  }
+  if (map->groups == NULL || map->chns == NULL || map->vals == NULL ||
+      (map->keyps == NULL && map->keys == NULL)) {
+    free(map->groups);
+    free(map->chns);
+    free(map->vals);
+    free(map->keyps);
+    free(map->keys);
+    free(map);
+    return 0;
+  }
+  memset(map->groups, MAP_CTRL_EMPTY, sizeof(struct MapGroup) * group_count);
+  map->group_mask = group_count - 1;
+  map->capacity = capacity;
+  map->size = 0;
+  map->keys_eq = keq;
+  map->khash = khash;
+  *map_out = map;
+  return 1;
+}
+
+int map_allocate(map_keys_equality* keq, map_key_hash* khash,
+                 unsigned capacity, struct Map** map_out) {
+  return map_allocate_sized(keq, khash, 0, capacity, map_out);
+}
+
+int map_get_hashed(struct Map* map, void* key, unsigned hash, int* value_out) {
+  return map_typed_get(map, map->keys_eq, map->key_size, map->group_mask, key,
+                       hash, value_out);
+}
+
+int map_get(struct Map* map, void* key, int* value_out) {
+  return map_get_hashed(map, key, map->khash(key), value_out);
+}
+
+void map_put_hashed(struct Map* map, void* key, unsigned hash, int value) {
+  map_typed_put(map, map->key_size, map->group_mask, key, hash, value);
+}
+
+void map_put(struct Map* map, void* key, int value) {
+  map_put_hashed(map, key, map->khash(key), value);
+}
+
+void map_erase_hashed(struct Map* map, void* key, unsigned hash,
+                      void** trash) {
+  map_typed_erase(map, map->keys_eq, map->key_size, map->group_mask, key, hash,
+                  trash);
+}
+
+void map_erase(struct Map* map, void* key, void** trash) {
+  map_erase_hashed(map, key, map->khash(key), trash);
+}
+
+int map_get_or_reserve_hashed(struct Map* map, void* key, unsigned hash,
+                              int* value_out,
+                              struct MapReservation* reservation) {
+  return map_typed_get_or_reserve(map, map->keys_eq, map->key_size,
+                                  map->group_mask, key, hash, value_out,
+                                  reservation);
+}
+
+int map_get_or_reserve(struct Map* map, void* key, int* value_out,
+                       struct MapReservation* reservation) {
+  return map_get_or_reserve_hashed(map, key, map->khash(key), value_out,
+                                   reservation);
+}
+
+void map_commit(struct Map* map, struct MapReservation* reservation,
+                void* key, int value) {
+  map_typed_commit(map, map->key_size, map->group_mask, reservation, key,
+                   value);
+}
+
+unsigned map_size(struct Map* map) {
+  return map->size;
+}
+
+void map_prefetch_hashed(struct Map* map, unsigned hash) {
+  // The control bytes of the home group; its keys depend on them
+  unsigned g = map_home_group(map->group_mask, hash);
+  __builtin_prefetch(&map->groups[g]);
+  __builtin_prefetch(&map->chns[g]);
+}
+
+int map_get_bulk(struct Map* map, void** keys, unsigned count,
+                 int* values_out, uint64_t* found_mask) {
+  // First, hash all keys and prefetch the control bytes of their groups...
+  unsigned hashes[MAP_BULK_MAX];
+  for (unsigned n = 0; n < count; n++) {
+    hashes[n] = map->khash(keys[n]);
+    map_prefetch_hashed(map, hashes[n]);
+  }
+
+  // ...then prefetch the key and value of the first fingerprint match...
+  for (unsigned n = 0; n < count; n++) {
+    unsigned g = map_home_group(map->group_mask, hashes[n]);
+    unsigned mask =
+        map_group_match(&map->groups[g], map_fingerprint(hashes[n]));
+    if (mask != 0) {
+      unsigned index = g * MAP_GROUP_SLOTS + __builtin_ctz(mask);
+      __builtin_prefetch(map_slot_key(map, map->key_size, index));
+      __builtin_prefetch(&map->vals[index]);
+    }
+  }
+
+  // ...and finally compare
+  int found = 0;
+  *found_mask = 0;
+  for (unsigned n = 0; n < count; n++) {
+    if (map_typed_get(map, map->keys_eq, map->key_size, map->group_mask,
+                      keys[n], hashes[n], &values_out[n])) {
+      *found_mask |= UINT64_C(1) << n;
+      found++;
+    }
+  }
+  return found;
+}
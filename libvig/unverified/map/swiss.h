@@ -0,0 +1,223 @@
+#ifndef _MAP_SWISS_H_INCLUDED_
+#define _MAP_SWISS_H_INCLUDED_
+
+// Layout and probing of the swiss map, see swiss.c.
+// The probing functions take the key equality, the size of inline keys and
+// the group mask as parameters instead of reading them from the map, so that
+// map-typed.h can instantiate them for a key type, with the first two known at
+// compile time, and the last one too for a capacity fixed at build time.
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "libvig/verified/map.h"
+#include "libvig/unverified/map-ext.h"
+
+// Keys up to this size are copied into the map, larger ones are kept by pointer
+#ifndef MAP_INLINE_KEY_SIZE
+#  define MAP_INLINE_KEY_SIZE 16
+#endif
+#define MAP_GROUP_SLOTS 16
+#define MAP_CTRL_EMPTY 0x80
+
+struct MapGroup {
+  uint8_t ctrl[MAP_GROUP_SLOTS];
+} __attribute__((aligned(MAP_GROUP_SLOTS)));
+
+struct Map {
+  struct MapGroup* groups;
+  unsigned* chns;   // per group
+  int* vals;        // per slot
+  uint8_t* keys;    // per slot, if the keys are inline
+  void** keyps;     // per slot, if the keys are not inline
+  unsigned group_mask;
+  unsigned key_size; // 0 if the keys are not inline
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+// The group mask of a map of the given capacity, which has a power of 2 of
+// groups such that it is at most 7/8 full, since lookups compare whole groups
+// at once, but chains still grow quickly in an almost full map; a constant
+// expression if the capacity is one
+#define MAP_CAPACITY_MASK(capacity)                                            \
+  ((unsigned)MAP_POW2_CEIL(((uint64_t)(capacity) + (capacity) / 8 +            \
+                            MAP_GROUP_SLOTS - 1) / MAP_GROUP_SLOTS) - 1)
+
+static inline unsigned map_mask(struct Map* map) {
+  return map->group_mask;
+}
+
+static inline unsigned map_home_group(unsigned group_mask, unsigned key_hash) {
+  return (key_hash >> 7) & group_mask;
+}
+
+static inline uint8_t map_fingerprint(unsigned key_hash) {
+  return key_hash & 0x7F;
+}
+
+// Bitmask of the slots of the group whose control byte is the given one
+static inline unsigned map_group_match(struct MapGroup* group, uint8_t ctrl) {
+#ifdef __SSE2__
+  __m128i ctrls = _mm_load_si128((__m128i*)group->ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, _mm_set1_epi8(ctrl)));
+#else  // __SSE2__
+  unsigned mask = 0;
+  for (unsigned s = 0; s < MAP_GROUP_SLOTS; ++s) {
+    mask |= (unsigned)(group->ctrl[s] == ctrl) << s;
+  }
+  return mask;
+#endif // __SSE2__
+}
+
+static inline __attribute__((always_inline)) void*
+map_slot_key(struct Map* map, unsigned key_size, unsigned index) {
+  if (key_size == 0) {
+    return map->keyps[index];
+  }
+  return &map->keys[index * key_size];
+}
+
+// Returns the index of the given key, or -1 if it is not in the map
+static inline __attribute__((always_inline)) int
+map_find_key(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+             unsigned group_mask, void* keyp, unsigned key_hash) {
+  unsigned g = map_home_group(group_mask, key_hash);
+  uint8_t fp = map_fingerprint(key_hash);
+  for (unsigned i = 0; i <= group_mask; ++i) {
+    unsigned mask = map_group_match(&map->groups[g], fp);
+    while (mask != 0) {
+      unsigned index = g * MAP_GROUP_SLOTS + __builtin_ctz(mask);
+      if (keys_eq(map_slot_key(map, key_size, index), keyp)) {
+        return (int)index;
+      }
+      mask &= mask - 1;
+    }
+    if (map->chns[g] == 0) {
+      return -1;
+    }
+    g = (g + 1) & group_mask;
+  }
+  return -1;
+}
+
+static inline __attribute__((always_inline)) void
+map_put_slot(struct Map* map, unsigned key_size, unsigned g, void* key,
+             unsigned key_hash, int value) {
+  unsigned s = __builtin_ctz(map_group_match(&map->groups[g], MAP_CTRL_EMPTY));
+  unsigned index = g * MAP_GROUP_SLOTS + s;
+  map->groups[g].ctrl[s] = map_fingerprint(key_hash);
+  map->vals[index] = value;
+  if (key_size == 0) {
+    map->keyps[index] = key;
+  } else {
+    memcpy(&map->keys[index * key_size], key, key_size);
+  }
+  map->size++;
+}
+
+static inline __attribute__((always_inline)) int
+map_typed_get(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+              unsigned group_mask, void* key, unsigned hash, int* value_out) {
+  int index = map_find_key(map, keys_eq, key_size, group_mask, key, hash);
+  if (index == -1) {
+    return 0;
+  }
+  *value_out = map->vals[index];
+  return 1;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_put(struct Map* map, unsigned key_size, unsigned group_mask,
+              void* key, unsigned hash, int value) {
+  unsigned g = map_home_group(group_mask, hash);
+  // There is an empty slot, since the map is not full
+  while (map_group_match(&map->groups[g], MAP_CTRL_EMPTY) == 0) {
+    map->chns[g]++;
+    g = (g + 1) & group_mask;
+  }
+  map_put_slot(map, key_size, g, key, hash, value);
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_erase(struct Map* map, map_keys_equality* keys_eq, unsigned key_size,
+                unsigned group_mask, void* key, unsigned hash, void** trash) {
+  int index = map_find_key(map, keys_eq, key_size, group_mask, key, hash);
+  // The key is in the map; undo the chain counting of map_put
+  for (unsigned g = map_home_group(group_mask, hash);
+       g != (unsigned)index / MAP_GROUP_SLOTS;
+       g = (g + 1) & group_mask) {
+    map->chns[g]--;
+  }
+  // With inline keys, the map holds no pointer to give back, and the caller's
+  // key is just as good since the key pointers that libVig hands back only
+  // matter for the proofs.
+  *trash = key_size == 0 ? map->keyps[index] : key;
+  map->groups[index / MAP_GROUP_SLOTS].ctrl[index % MAP_GROUP_SLOTS] =
+      MAP_CTRL_EMPTY;
+  map->size--;
+}
+
+// The reservation is the first group with an empty slot, and how many groups
+// away from the home group it is
+static inline __attribute__((always_inline)) int
+map_typed_get_or_reserve(struct Map* map, map_keys_equality* keys_eq,
+                         unsigned key_size, unsigned group_mask, void* key,
+                         unsigned hash, int* value_out,
+                         struct MapReservation* reservation) {
+  unsigned g = map_home_group(group_mask, hash);
+  uint8_t fp = map_fingerprint(hash);
+  reservation->hash = hash;
+  reservation->index = -1;
+
+  unsigned i = 0;
+  for (; i <= group_mask; ++i) {
+    if (reservation->index == -1 &&
+        map_group_match(&map->groups[g], MAP_CTRL_EMPTY) != 0) {
+      reservation->index = (int)g;
+      reservation->distance = i;
+    }
+    unsigned mask = map_group_match(&map->groups[g], fp);
+    while (mask != 0) {
+      unsigned index = g * MAP_GROUP_SLOTS + __builtin_ctz(mask);
+      if (keys_eq(map_slot_key(map, key_size, index), key)) {
+        *value_out = map->vals[index];
+        return 1;
+      }
+      mask &= mask - 1;
+    }
+    if (map->chns[g] == 0) {
+      break;
+    }
+    g = (g + 1) & group_mask;
+  }
+
+  // The empty slot may be past the end of the chain
+  for (; reservation->index == -1 && i <= group_mask; ++i) {
+    if (map_group_match(&map->groups[g], MAP_CTRL_EMPTY) != 0) {
+      reservation->index = (int)g;
+      reservation->distance = i;
+    }
+    g = (g + 1) & group_mask;
+  }
+  return 0;
+}
+
+static inline __attribute__((always_inline)) void
+map_typed_commit(struct Map* map, unsigned key_size, unsigned group_mask,
+                 struct MapReservation* reservation, void* key, int value) {
+  unsigned g = map_home_group(group_mask, reservation->hash);
+  for (unsigned i = 0; i < reservation->distance; ++i) {
+    map->chns[g]++;
+    g = (g + 1) & group_mask;
+  }
+  map_put_slot(map, key_size, (unsigned)reservation->index, key,
+               reservation->hash, value);
+}
+
+#endif//_MAP_SWISS_H_INCLUDED_
@@ -0,0 +1,28 @@
+#ifndef _PACKED_KEYS_H_INCLUDED_
+#define _PACKED_KEYS_H_INCLUDED_
+
+#include <stdint.h>
+#include <string.h>
+
+// Unverified helpers for the equality and hash functions that codegen
+// generates with VIGOR_PACKED_KEYS for structs of up to 32 bytes: instead of
+// going field by field, they compare and hash structs as whole 64-bit words,
+// plus a 32-bit one if their size is not a multiple of 8. The padding bytes
+// of each word are masked out, since C leaves their contents unspecified, e.g.
+// in keys built field by field on the stack.
+
+//   Load the 64-bit word at the given byte offset of a key.
+static inline uint64_t packed_key_word(void* key, unsigned offset) {
+  uint64_t word;
+  memcpy(&word, (uint8_t*)key + offset, sizeof(word));
+  return word;
+}
+
+//   Load the 32-bit word at the given byte offset of a key.
+static inline uint32_t packed_key_word32(void* key, unsigned offset) {
+  uint32_t word;
+  memcpy(&word, (uint8_t*)key + offset, sizeof(word));
+  return word;
+}
+
+#endif//_PACKED_KEYS_H_INCLUDED_
@@ -0,0 +1,47 @@
+#include "rss.h"
+
+#include <rte_byteorder.h>
+
+// The 16-bit pattern of the symmetric key
+#define RSS_KEY_PATTERN 0x6d5a
+
+// The hash of the XOR of the 16-bit words of the input, one table per byte
+static uint16_t rss_table_hi[256];
+static uint16_t rss_table_lo[256];
+
+void rss_fill_symmetric_key(uint8_t* key, uint8_t size) {
+  for (uint8_t n = 0; n < size; n++) {
+    key[n] = n % 2 == 0 ? RSS_KEY_PATTERN >> 8 : RSS_KEY_PATTERN & 0xff;
+  }
+}
+
+// The Toeplitz hash XORs, for every set bit of the input, the 32 bits of the
+// key starting at the same bit; with a 16-bit pattern, that is the pattern
+// rotated by the bit index, twice
+__attribute__((constructor))
+static void rss_init_tables(void) {
+  for (unsigned byte = 0; byte < 256; byte++) {
+    uint16_t hi = 0;
+    uint16_t lo = 0;
+    for (unsigned bit = 0; bit < 8; bit++) {
+      if (byte & (0x80 >> bit)) {
+        hi ^= (uint16_t)((RSS_KEY_PATTERN << bit) |
+                         (RSS_KEY_PATTERN >> (16 - bit)));
+        lo ^= (uint16_t)((RSS_KEY_PATTERN << (bit + 8)) |
+                         (RSS_KEY_PATTERN >> (8 - bit)));
+      }
+    }
+    rss_table_hi[byte] = hi;
+    rss_table_lo[byte] = lo;
+  }
+}
+
+uint32_t rss_hash_ipv4(uint32_t src_ip, uint32_t dst_ip, uint16_t src_port,
+                       uint16_t dst_port) {
+  // XOR commutes with byte swaps, so swap once at the end
+  uint16_t words = (uint16_t)(src_ip ^ (src_ip >> 16) ^ dst_ip ^ (dst_ip >> 16) ^
+                              src_port ^ dst_port);
+  words = rte_be_to_cpu_16(words);
+  uint16_t hash = rss_table_hi[words >> 8] ^ rss_table_lo[words & 0xff];
+  return ((uint32_t)hash << 16) | hash;
+}
@@ -0,0 +1,41 @@
+#ifndef _RSS_H_INCLUDED_
+#define _RSS_H_INCLUDED_
+
+#include <stdint.h>
+
+// Unverified helpers for the symmetric RSS that nf.c configures on devices with
+// VIGOR_MULTICORE or VIGOR_RSS_HASH, so that both directions of a flow get the
+// same Toeplitz hash.
+// With VIGOR_RSS_HASH, the generated hash functions of structs with src_ip,
+// dst_ip, src_port and dst_port fields use rss_flow_hash, so that NFs can reuse
+// the hash devices compute instead of hashing flows again, see nf_rss_hash.
+
+//   Fill the given RSS key such that the Toeplitz hash is symmetric, i.e. the
+//   same if source and destination addresses and ports are swapped, see
+//   "Scalable TCP Session Monitoring with Symmetric Receive-side Scaling".
+void rss_fill_symmetric_key(uint8_t* key, uint8_t size);
+
+//   Compute the Toeplitz hash of IPv4 addresses and ports, given in network
+//   order, with a key from rss_fill_symmetric_key, as devices do.
+//   The key repeats every 16 bits, thus the hash only depends on the XOR of
+//   the 16-bit words of its input, and its two halves are equal.
+uint32_t rss_hash_ipv4(uint32_t src_ip, uint32_t dst_ip, uint16_t src_port,
+                       uint16_t dst_port);
+
+//   Number of distinct hashes of flows, too few for hash tables of more flows.
+#define RSS_FLOW_HASHES (1 << 16)
+
+//   Spread the 16 significant bits of a hash from rss_hash_ipv4 over all of
+//   its bits, for hash tables that use different bits for different purposes.
+static inline uint32_t rss_mix(uint32_t rss_hash) {
+  uint32_t hash = (rss_hash & 0xffff) * 0x9e3779b1u;
+  return hash ^ (hash >> 16);
+}
+
+//   The hash of a flow, to use in hash tables.
+static inline uint32_t rss_flow_hash(uint32_t src_ip, uint32_t dst_ip,
+                                     uint16_t src_port, uint16_t dst_port) {
+  return rss_mix(rss_hash_ipv4(src_ip, dst_ip, src_port, dst_port));
+}
+
+#endif//_RSS_H_INCLUDED_
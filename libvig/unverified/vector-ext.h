@@ -0,0 +1,42 @@
+#ifndef _VECTOR_EXT_H_INCLUDED_
+#define _VECTOR_EXT_H_INCLUDED_
+
+#include "libvig/verified/vector.h"
+
+// Unverified extensions to the Vector API, implemented by the alternative
+// vector implementation in vector/records.c, selected with VIGOR_VECTOR=records.
+// They let several vectors indexed alike, e.g. by the same double chain, store
+// their elements of the same index together in one record, so that accessing
+// all of them touches a single cache line instead of one per vector.
+
+//   Get the distance between records of the given size, which is larger if
+//   needed so that records do not straddle cache lines.
+unsigned vector_record_stride(unsigned record_size);
+
+// The same as a constant expression, for records in static arrays: the next
+// power of 2 up to a cache line, a multiple of the 64-byte cache line above.
+#define VECTOR_RECORD_STRIDE(record_size)                                      \
+  ((record_size) > 64 ? ((record_size) + 63) / 64 * 64                         \
+   : (record_size) > 32 ? 64                                                   \
+   : (record_size) > 16 ? 32                                                   \
+   : (record_size) > 8 ? 16                                                    \
+   : (record_size) > 4 ? 8                                                     \
+   : (record_size) > 2 ? 4                                                     \
+   : (record_size) > 1 ? 2 : 1)
+
+//   Allocate memory for the given number of records, which is never freed.
+//   @param stride - the distance between records, see vector_record_stride.
+//   @param capacity - the number of records.
+//   @returns the first record, or NULL if there is not enough memory.
+void* vector_allocate_records(unsigned stride, unsigned capacity);
+
+//   The same as vector_allocate, with the element of index i at
+//   first_elem + i*stride instead of in an array owned by the vector.
+//   @param first_elem - where the element of index 0 is, within the first
+//                       record of vector_allocate_records.
+//   @param stride - the distance between records.
+int vector_allocate_in(int elem_size, unsigned capacity,
+                       vector_init_elem* init_elem, void* first_elem,
+                       unsigned stride, struct Vector** vector_out);
+
+#endif//_VECTOR_EXT_H_INCLUDED_
@@ -0,0 +1,74 @@
+// Unverified alternative to libvig/verified/vector.c, selected with
+// VIGOR_VECTOR=records.
+// Elements are separated by a stride, which is their size for vectors from
+// vector_allocate, and that of the records they are part of for vectors from
+// vector_allocate_in, see libvig/unverified/vector-ext.h.
+
+#include "libvig/verified/vector.h"
+#include "libvig/unverified/vector-ext.h"
+
+#include <stdlib.h>
+#ifdef VIGOR_HUGEPAGES
+#  include "libvig/unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
+
+#define CACHE_LINE_SIZE 64
+
+struct Vector {
+  char* data;
+  unsigned stride;
+};
+
+int vector_allocate_in(int elem_size, unsigned capacity,
+                       vector_init_elem* init_elem, void* first_elem,
+                       unsigned stride, struct Vector** vector_out) {
+  struct Vector* vector = (struct Vector*)malloc(sizeof(struct Vector));
+  if (vector == NULL) {
+    return 0;
+  }
+  vector->data = (char*)first_elem;
+  vector->stride = stride;
+  for (unsigned i = 0; i < capacity; ++i) {
+    init_elem(vector->data + (size_t)i * stride);
+  }
+  (void)elem_size;
+  *vector_out = vector;
+  return 1;
+}
+
+int vector_allocate(int elem_size, unsigned capacity,
+                    vector_init_elem* init_elem, struct Vector** vector_out) {
+  char* data = (char*)malloc((size_t)elem_size * capacity);
+  if (data == NULL) {
+    return 0;
+  }
+  if (!vector_allocate_in(elem_size, capacity, init_elem, data, elem_size,
+                          vector_out)) {
+    free(data);
+    return 0;
+  }
+  return 1;
+}
+
+unsigned vector_record_stride(unsigned record_size) {
+  // A power of 2 up to a line, so that records are within a line of an
+  // aligned array
+  return VECTOR_RECORD_STRIDE(record_size);
+}
+
+void* vector_allocate_records(unsigned stride, unsigned capacity) {
+  size_t size = (size_t)stride * capacity;
+  // aligned_alloc wants a multiple of the alignment
+  size = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+  return aligned_alloc(CACHE_LINE_SIZE, size);
+}
+
+void vector_borrow(struct Vector* vector, int index, void** val_out) {
+  *val_out = vector->data + (size_t)index * vector->stride;
+}
+
+void vector_return(struct Vector* vector, int index, void* value) {
+  (void)vector;
+  (void)index;
+  (void)value;
+}
@@ -0,0 +1,115 @@
+// Unverified alternative to libvig/verified/vigor-time.c, selected with
+// VIGOR_TIME=tsc.
+// Reads the TSC instead of calling clock_gettime, and converts cycles to
+// nanoseconds with a multiplication and a shift by a factor computed once from
+// the calibrated TSC frequency, instead of a division every time.
+// This assumes an invariant TSC, as DPDK does; the result is still clamped to
+// never go below the previous one, as the verified code expects.
+
+#include "libvig/verified/vigor-time.h"
+#include "libvig/verified/lcore-local.h"
+
+#include <time.h>
+#include <assert.h>
+
+#ifdef NFOS
+#  include <nfos_tsc.h>
+#else // NFOS
+#  include <rte_cycles.h>
+#endif // NFOS
+
+// Nanoseconds are (cycles * tsc_mult) >> TSC_SHIFT
+#define TSC_SHIFT 32
+
+VIGOR_LCORE_LOCAL vigor_time_t last_time = 0;
+
+static VIGOR_LCORE_LOCAL uint64_t tsc_mult = 0;
+static VIGOR_LCORE_LOCAL uint64_t tsc_base = 0;
+static VIGOR_LCORE_LOCAL uint64_t ns_base = 0;
+
+static inline uint64_t tsc_read(void) {
+#ifdef NFOS
+  return nfos_rdtsc();
+#else // NFOS
+  return rte_rdtsc();
+#endif // NFOS
+}
+
+static inline uint64_t tsc_to_ns(uint64_t tsc) {
+  // A single 64x64->128 multiplication on x86-64
+  return ns_base + (uint64_t)(((__uint128_t)(tsc - tsc_base) * tsc_mult) >>
+                              TSC_SHIFT);
+}
+
+// Must run after the TSC frequency is known, i.e., after rte_eal_init
+static void tsc_calibrate(void) {
+#ifdef NFOS
+  uint64_t freq = nfos_tsc_get_freq();
+#else // NFOS
+  uint64_t freq = rte_get_tsc_hz();
+#endif // NFOS
+  assert(freq != 0);
+  tsc_mult = (((__uint128_t)VIGOR_TIME_SECONDS_MULTIPLIER << TSC_SHIFT) +
+              freq / 2) /
+             freq;
+
+#ifdef NFOS
+  // The TSC is the only clock, see clock_gettime below
+  tsc_base = 0;
+  ns_base = 0;
+#else // NFOS
+  // Start from the monotonic clock, so that times are the same as with the
+  // verified implementation, and consistent across lcores
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  tsc_base = tsc_read();
+  ns_base = tp.tv_sec * VIGOR_TIME_SECONDS_MULTIPLIER + tp.tv_nsec;
+#endif // NFOS
+}
+
+#ifdef NFOS
+time_t time(time_t *timer) { assert(0); }
+
+int clock_gettime(clockid_t clk_id, struct timespec *tp) {
+  // Others not implemented
+  if (clk_id != CLOCK_MONOTONIC && clk_id != CLOCK_MONOTONIC_RAW) {
+    return -1;
+  }
+
+  if (tsc_mult == 0) {
+    tsc_calibrate();
+  }
+  uint64_t time_ns = tsc_to_ns(tsc_read());
+  tp->tv_nsec = time_ns % VIGOR_TIME_SECONDS_MULTIPLIER;
+  tp->tv_sec = time_ns / VIGOR_TIME_SECONDS_MULTIPLIER;
+  return 0;
+}
+
+int gettimeofday(struct timeval *tv, void* tz)
+{
+  if (tz != NULL) {
+    return -1;
+  }
+  struct timespec tp;
+  int ret = clock_gettime(CLOCK_MONOTONIC, &tp);
+  if (ret != 0) {
+    return ret;
+  }
+  tv->tv_sec = tp.tv_sec;
+  tv->tv_usec = tp.tv_nsec / 1000;
+  return 0;
+}
+#endif
+
+vigor_time_t current_time(void) {
+  if (tsc_mult == 0) {
+    tsc_calibrate();
+  }
+  vigor_time_t now = (vigor_time_t)tsc_to_ns(tsc_read());
+  if (now > last_time) {
+    last_time = now;
+  }
+  return last_time;
+}
+
+vigor_time_t recent_time(void) { return last_time; }
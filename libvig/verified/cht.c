@@ -1,6 +1,9 @@
 #include "cht.h"
 #include <assert.h>
 #include <stdlib.h>
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 //@ #include "../proof/prime.gh"
 //@ #include "../proof/permutations.gh"
@@ -4,6 +4,9 @@
 #include <stddef.h>
 
 #include "double-chain-impl.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 //@ #include <nat.gh>
 //@ #include "../proof/arith.gh"
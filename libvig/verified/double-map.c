@@ -9,6 +9,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stddef.h>
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 //@ #include "../proof/arith.gh"
 
@@ -0,0 +1,14 @@
+#ifndef _LCORE_LOCAL_H_INCLUDED_
+#define _LCORE_LOCAL_H_INCLUDED_
+
+// Storage class for globals that hold the state of the packet being processed
+// or of the NF itself. With the (unverified) VIGOR_MULTICORE option, each lcore
+// runs its own NF instance, so each lcore gets its own copy of these globals.
+// Verification is single-threaded, so they are plain globals otherwise.
+#ifdef VIGOR_MULTICORE
+#  define VIGOR_LCORE_LOCAL __thread
+#else // VIGOR_MULTICORE
+#  define VIGOR_LCORE_LOCAL
+#endif // VIGOR_MULTICORE
+
+#endif //_LCORE_LOCAL_H_INCLUDED_
@@ -1,4 +1,7 @@
 #include "lpm-dir-24-8.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 //@ #include "../proof/lpm-dir-24-8-lemmas.gh"
 
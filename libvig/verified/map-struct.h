@@ -0,0 +1,20 @@
+#ifndef _MAP_STRUCT_H_INCLUDED_
+#define _MAP_STRUCT_H_INCLUDED_
+
+#include "map-util.h"
+
+// The layout of the map, shared with the unverified extensions in
+// libvig/unverified/map-ext.c; everyone else must use map.h
+struct Map {
+  int* busybits;
+  void** keyps;
+  unsigned* khs;
+  int* chns;
+  int* vals;
+  unsigned capacity;
+  unsigned size;
+  map_keys_equality* keys_eq;
+  map_key_hash* khash;
+};
+
+#endif//_MAP_STRUCT_H_INCLUDED_
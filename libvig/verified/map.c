@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include "map.h"
+#include "map-struct.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 #ifdef CAPACITY_POW2
 #include "map-impl-pow2.h"
@@ -8,18 +12,6 @@
 #include "map-impl.h"
 #endif
 
-struct Map {
-  int* busybits;
-  void** keyps;
-  unsigned* khs;
-  int* chns;
-  int* vals;
-  unsigned capacity;
-  unsigned size;
-  map_keys_equality* keys_eq;
-  map_key_hash* khash;
-};
-
 /*@
   predicate mapp<t>(struct Map* ptr,
                     predicate (void*;t) kp,
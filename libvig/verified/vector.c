@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "vector.h"
+#ifdef VIGOR_HUGEPAGES
+#  include "../unverified/alloc.h"
+#endif//VIGOR_HUGEPAGES
 
 //@ #include "../proof/arith.gh"
 //@ #include "../proof/stdex.gh"
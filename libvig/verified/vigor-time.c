@@ -1,4 +1,5 @@
 #include "vigor-time.h"
+#include "lcore-local.h"
 
 #include <time.h>
 #include <assert.h>
@@ -7,7 +8,7 @@
 #  include <nfos_tsc.h>
 #endif
 
-vigor_time_t last_time = 0;
+VIGOR_LCORE_LOCAL vigor_time_t last_time = 0;
 
 #ifdef NFOS
 time_t time(time_t *timer) { assert(0); }
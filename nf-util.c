@@ -10,13 +10,14 @@
 #include <rte_udp.h>
 
 #include "nf-util.h"
+#include "nf-log.h"
 
 #ifdef KLEE_VERIFICATION
 #  include <klee/klee.h>
 #endif
 
-void *chunks_borrowed[MAX_N_CHUNKS];
-size_t chunks_borrowed_num = 0;
+VIGOR_LCORE_LOCAL void *chunks_borrowed[MAX_N_CHUNKS];
+VIGOR_LCORE_LOCAL size_t chunks_borrowed_num = 0;
 
 bool nf_has_rte_ipv4_header(struct rte_ether_hdr *header) {
   return header->ether_type == rte_be_to_cpu_16(RTE_ETHER_TYPE_IPV4);
@@ -62,6 +63,83 @@ void nf_set_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
   }
   ip_header->hdr_checksum = rte_ipv4_cksum(ip_header);
 }
+
+bool nf_tx_cksum_offload[RTE_MAX_ETHPORTS];
+
+bool nf_rx_ptypes[RTE_MAX_ETHPORTS];
+
+#ifdef VIGOR_RSS_HASH
+bool nf_rx_rss_hash[RTE_MAX_ETHPORTS];
+
+VIGOR_LCORE_LOCAL uint32_t nf_rss_hash_checked[RTE_MAX_ETHPORTS];
+
+void nf_rss_hash_check(uint16_t device, uint32_t device_hash, uint32_t hash) {
+  // Only the bits that rss_mix keeps matter
+  if (rss_mix(device_hash) == rss_mix(hash)) {
+    nf_rss_hash_checked[device]++;
+  } else {
+    nf_rss_hash_checked[device] = NF_RSS_HASH_MISMATCH;
+    NF_INFO("Device %" PRIu16 " computes RSS hashes that differ from "
+            "rss_hash_ipv4, hashing its packets in software.", device);
+  }
+}
+#endif // VIGOR_RSS_HASH
+
+// RFC 1624 eqn. 3, HC' = ~(~HC + ~m + m'), for a 32-bit field m;
+// one's complement sums do not depend on the byte order, so all of these are in
+// network order
+static uint16_t nf_cksum_adjust(uint16_t cksum, uint32_t old_val,
+                                uint32_t new_val) {
+  uint32_t sum = (uint16_t)~cksum;
+  sum += (uint16_t)~old_val + (uint16_t)~(old_val >> 16);
+  sum += (uint16_t)new_val + (uint16_t)(new_val >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t)~sum;
+}
+
+void nf_update_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
+                                        struct tcpudp_hdr *l4_header,
+                                        uint32_t old_addr, uint32_t new_addr,
+                                        uint16_t old_port, uint16_t new_port) {
+  ip_header->hdr_checksum =
+      nf_cksum_adjust(ip_header->hdr_checksum, old_addr, new_addr);
+  // The L4 checksums cover the addresses too, through the pseudo-header
+  if (ip_header->next_proto_id == IPPROTO_TCP) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    tcp_header->cksum = nf_cksum_adjust(
+        nf_cksum_adjust(tcp_header->cksum, old_addr, new_addr), old_port,
+        new_port);
+  } else if (ip_header->next_proto_id == IPPROTO_UDP) {
+    struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
+    // A zero UDP checksum means there is none, and a zero sum is sent as 0xffff
+    if (udp_header->dgram_cksum != 0) {
+      uint16_t cksum = nf_cksum_adjust(
+          nf_cksum_adjust(udp_header->dgram_cksum, old_addr, new_addr),
+          old_port, new_port);
+      udp_header->dgram_cksum = cksum == 0 ? 0xffff : cksum;
+    }
+  }
+}
+
+void nf_offload_rte_ipv4_udptcp_checksum(struct rte_mbuf *mbuf,
+                                         struct rte_ipv4_hdr *ip_header,
+                                         struct tcpudp_hdr *l4_header) {
+  mbuf->l2_len = sizeof(struct rte_ether_hdr);
+  mbuf->l3_len = (ip_header->version_ihl & 0x0f) * WORD_SIZE;
+  mbuf->ol_flags |= PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+  ip_header->hdr_checksum = 0; // Assumed by the device
+  // The device sums the payload, but not the pseudo-header
+  if (ip_header->next_proto_id == IPPROTO_TCP) {
+    struct rte_tcp_hdr *tcp_header = (struct rte_tcp_hdr *)l4_header;
+    mbuf->ol_flags |= PKT_TX_TCP_CKSUM;
+    tcp_header->cksum = rte_ipv4_phdr_cksum(ip_header, mbuf->ol_flags);
+  } else if (ip_header->next_proto_id == IPPROTO_UDP) {
+    struct rte_udp_hdr *udp_header = (struct rte_udp_hdr *)l4_header;
+    mbuf->ol_flags |= PKT_TX_UDP_CKSUM;
+    udp_header->dgram_cksum = rte_ipv4_phdr_cksum(ip_header, mbuf->ol_flags);
+  }
+}
 #endif // KLEE_VERIFICATION
 
 uintmax_t nf_util_parse_int(const char *str, const char *name, int base,
@@ -10,9 +10,14 @@
 #include <rte_mbuf.h>
 #include <rte_ethdev.h>
 #include <rte_ip.h>
+#include "libvig/verified/lcore-local.h"
 #include "libvig/verified/packet-io.h"
 #include "libvig/verified/tcpudp_hdr.h"
 
+#ifdef VIGOR_RSS_HASH
+#  include "libvig/unverified/rss.h"
+#endif // VIGOR_RSS_HASH
+
 #ifdef KLEE_VERIFICATION
 #  include <rte_ether.h>
 #  include "libvig/models/str-descr.h"
@@ -68,16 +73,43 @@ bool nf_has_tcpudp_header(struct rte_ipv4_hdr *header);
 void nf_set_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
                                  struct tcpudp_hdr *l4_header, void *packet);
 
+#ifndef KLEE_VERIFICATION
+// Same as nf_set_rte_ipv4_udptcp_checksum, but for a packet whose checksums
+// were correct before an address and a port, either source or destination, were
+// changed from old_addr to new_addr and from old_port to new_port: adjusts the
+// checksums for these fields only (RFC 1624), instead of summing the payload.
+// Pass the same old and new value for a field that is not changed.
+void nf_update_rte_ipv4_udptcp_checksum(struct rte_ipv4_hdr *ip_header,
+                                        struct tcpudp_hdr *l4_header,
+                                        uint32_t old_addr, uint32_t new_addr,
+                                        uint16_t old_port, uint16_t new_port);
+
+// Whether each device computes IPv4 and TCP/UDP checksums on transmission;
+// nf.c enables it in the (unverified) batched build for devices that can.
+extern bool nf_tx_cksum_offload[RTE_MAX_ETHPORTS];
+
+// Same as nf_set_rte_ipv4_udptcp_checksum, but only prepares the given packet
+// for a device that computes the checksums, see nf_tx_cksum_offload.
+void nf_offload_rte_ipv4_udptcp_checksum(struct rte_mbuf *mbuf,
+                                         struct rte_ipv4_hdr *ip_header,
+                                         struct tcpudp_hdr *l4_header);
+#endif // KLEE_VERIFICATION
+
 uintmax_t nf_util_parse_int(const char *str, const char *name, int base,
                             char next);
 
+// Largest capacity of a libVig container with elements of the given size, at
+// run time: indices are ints, and vectors compute offsets as ints too.
+// Note that the libVig proofs only hold below CAPACITY_UPPER_LIMIT and friends.
+#define NF_MAX_CAPACITY(elem_size) (INT32_MAX / (elem_size))
+
 char *nf_mac_to_str(struct rte_ether_addr *addr);
 
 char *nf_rte_ipv4_to_str(uint32_t addr);
 
 #define MAX_N_CHUNKS 100
-extern void *chunks_borrowed[];
-extern size_t chunks_borrowed_num;
+extern VIGOR_LCORE_LOCAL void *chunks_borrowed[];
+extern VIGOR_LCORE_LOCAL size_t chunks_borrowed_num;
 
 static inline void *nf_borrow_next_chunk(void *p, size_t length) {
   assert(chunks_borrowed_num < MAX_N_CHUNKS);
@@ -160,3 +192,112 @@ nf_then_get_tcpudp_header(struct rte_ipv4_hdr *ip_header, void *p) {
   return (struct tcpudp_hdr *)nf_borrow_next_chunk(p,
                                                    sizeof(struct tcpudp_hdr));
 }
+
+#ifndef KLEE_VERIFICATION
+// Gets the Ethernet, IPv4 and TCP/UDP headers of the given packet, the latter
+// two being NULL if absent, then returns all chunks; unlike the functions
+// above, this lets batched code parse all packets before processing them
+static inline void nf_get_headers(struct rte_mbuf *mbuf,
+                                  struct rte_ether_hdr **rte_ether_header,
+                                  struct rte_ipv4_hdr **rte_ipv4_header,
+                                  struct tcpudp_hdr **tcpudp_header) {
+  uint8_t *buffer = rte_pktmbuf_mtod(mbuf, uint8_t *);
+  packet_state_total_length(buffer, &(mbuf->pkt_len));
+  *rte_ether_header = nf_then_get_rte_ether_header(buffer);
+  uint8_t *ip_options;
+  *rte_ipv4_header =
+      nf_then_get_rte_ipv4_header(*rte_ether_header, buffer, &ip_options);
+  *tcpudp_header = *rte_ipv4_header == NULL
+                       ? NULL
+                       : nf_then_get_tcpudp_header(*rte_ipv4_header, buffer);
+  nf_return_all_chunks(buffer);
+}
+
+// Layers of mbuf->packet_type that NFs look at
+#  define NF_PTYPE_MASK                                                        \
+    (RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK | RTE_PTYPE_L4_MASK)
+
+// Whether each device sets mbuf->packet_type for IPv4 TCP/UDP packets;
+// nf.c sets it in the (unverified) batched build.
+extern bool nf_rx_ptypes[RTE_MAX_ETHPORTS];
+
+// Gets the type of the given packet, within NF_PTYPE_MASK, without reading the
+// packet; a layer may be unknown, i.e. 0, and all are if its device does not
+// classify packets, since classifying them in software would cost as much as
+// parsing them
+static inline uint32_t nf_packet_type(struct rte_mbuf *mbuf) {
+  if (nf_rx_ptypes[mbuf->port]) {
+    return mbuf->packet_type & NF_PTYPE_MASK;
+  }
+  return 0;
+}
+
+// Whether nf_then_get_rte_ipv4_header may find an IPv4 header in a packet of
+// the given type, i.e. whether it is not known to be something else, so that
+// NFs can drop other packets without reading them
+static inline bool nf_ptype_may_be_ipv4(uint32_t ptype) {
+  uint32_t l2 = ptype & RTE_PTYPE_L2_MASK;
+  uint32_t l3 = ptype & RTE_PTYPE_L3_MASK;
+  // Like nf_has_rte_ipv4_header, VLAN tags do not count
+  return ((l2 == 0) | (l2 == RTE_PTYPE_L2_ETHER)) &
+         ((l3 == 0) | RTE_ETH_IS_IPV4_HDR(l3));
+}
+
+// Same as nf_ptype_may_be_ipv4, for nf_then_get_tcpudp_header
+static inline bool nf_ptype_may_be_tcpudp(uint32_t ptype) {
+  uint32_t l4 = ptype & RTE_PTYPE_L4_MASK;
+  // Like nf_has_tcpudp_header, fragments count if they are TCP/UDP
+  return nf_ptype_may_be_ipv4(ptype) &
+         ((l4 == 0) | (l4 == RTE_PTYPE_L4_TCP) | (l4 == RTE_PTYPE_L4_UDP) |
+          (l4 == RTE_PTYPE_L4_FRAG));
+}
+#endif // KLEE_VERIFICATION
+
+#ifdef VIGOR_RSS_HASH
+// Whether each device computes the RSS hash of IPv4 TCP/UDP packets from their
+// addresses and ports, with the key nf.c gives it; nf.c sets it.
+extern bool nf_rx_rss_hash[RTE_MAX_ETHPORTS];
+
+// Number of packets from each device whose RSS hash nf_rss_hash checks against
+// rss_hash_ipv4 on each lcore, before using the device's hashes on that lcore
+#define NF_RSS_HASH_CHECKS 1024
+// Set instead of the number of checked packets once a hash did not match
+#define NF_RSS_HASH_MISMATCH UINT32_MAX
+
+// Number of packets from each device whose hash nf_rss_hash checked so far;
+// each lcore checks its own, since it has its own flow tables.
+extern VIGOR_LCORE_LOCAL uint32_t nf_rss_hash_checked[RTE_MAX_ETHPORTS];
+
+// Counts a packet whose RSS hash nf_rss_hash checked, or stops using the
+// hashes of the device if it does not match.
+void nf_rss_hash_check(uint16_t device, uint32_t device_hash, uint32_t hash);
+
+// Gets the hash of the flow of the given packet, as rss_flow_hash computes it,
+// using the RSS hash computed by the device if possible; thanks to the
+// symmetric RSS key, this is also the hash of the reverse flow.
+// Flow tables hash the same flows with rss_flow_hash elsewhere, so a device
+// whose hashes differ would make lookups miss flows that are there; the first
+// packets are thus hashed in software, and checked against the device.
+static inline unsigned nf_rss_hash(struct rte_mbuf *mbuf,
+                                   struct rte_ipv4_hdr *rte_ipv4_header,
+                                   struct tcpudp_hdr *tcpudp_header) {
+  // Devices hash fragments without their ports
+  bool fragment = (rte_ipv4_header->fragment_offset &
+                   rte_cpu_to_be_16(RTE_IPV4_HDR_MF_FLAG |
+                                    RTE_IPV4_HDR_OFFSET_MASK)) != 0;
+  bool device_hash = nf_rx_rss_hash[mbuf->port] & !fragment &
+                     ((mbuf->ol_flags & PKT_RX_RSS_HASH) != 0);
+  uint32_t checked = nf_rss_hash_checked[mbuf->port];
+  if (device_hash & (checked == NF_RSS_HASH_CHECKS)) {
+    return rss_mix(mbuf->hash.rss);
+  }
+  uint32_t hash = rss_hash_ipv4(rte_ipv4_header->src_addr,
+                                rte_ipv4_header->dst_addr,
+                                tcpudp_header->src_port,
+                                tcpudp_header->dst_port);
+  if (device_hash & (checked < NF_RSS_HASH_CHECKS)) {
+    nf_rss_hash_check(mbuf->port, mbuf->hash.rss, hash);
+  }
+  return rss_mix(hash);
+}
+#endif // VIGOR_RSS_HASH
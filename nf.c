@@ -3,6 +3,7 @@
 #include "nf-util.h"
 
 #include <inttypes.h>
+#include <string.h>
 
 #include <rte_common.h>
 #include <rte_eal.h>
@@ -27,9 +28,20 @@
 #  define MAIN main
 #endif // NFOS
 
-// Unverified support for batching, useful for performance comparisons
-#ifndef VIGOR_BATCH_SIZE
-#  define VIGOR_BATCH_SIZE 1
+// Unverified support for multiple cores: each lcore runs its own NF instance,
+// with its own state and its own RX/TX queue on every device,
+// and symmetric RSS sends both directions of a flow to the same lcore
+#if defined(VIGOR_MULTICORE) && (defined(KLEE_VERIFICATION) || defined(NFOS))
+#  error "Multicore support is not verified, and not available on NFOS"
+#endif
+
+// Unverified reuse of the RSS hash that devices compute, see nf_rss_hash
+#if defined(VIGOR_RSS_HASH) && (defined(KLEE_VERIFICATION) || defined(NFOS))
+#  error "Reusing RSS hashes is not verified, and not available on NFOS"
+#endif
+
+#if defined(VIGOR_MULTICORE) || defined(VIGOR_RSS_HASH)
+#  include "libvig/unverified/rss.h"
 #endif
 
 // More elaborate loop shape with annotations for verification
@@ -62,6 +74,14 @@
 #endif // KLEE_VERIFICATION
 
 
+// Storage class for the device settings below, which the unverified batched
+// build lets users change from the command line, see parse_tuning_options
+#if VIGOR_BATCH_SIZE == 1
+#  define NF_TUNABLE const
+#else
+#  define NF_TUNABLE
+#endif
+
 #if VIGOR_BATCH_SIZE == 1
 // Queue sizes for receiving/transmitting packets
 // NOT powers of 2 so that ixgbe doesn't use vector stuff
@@ -71,21 +91,52 @@ static const uint16_t RX_QUEUE_SIZE = 96;
 static const uint16_t TX_QUEUE_SIZE = 96;
 #else
 // Do the opposite: we want batching!
-static const uint16_t RX_QUEUE_SIZE = 128;
-static const uint16_t TX_QUEUE_SIZE = 128;
+static NF_TUNABLE uint16_t RX_QUEUE_SIZE = 128;
+static NF_TUNABLE uint16_t TX_QUEUE_SIZE = 128;
+
+// Whether to let PMDs use their vector RX/TX paths, which most of them only do
+// without offloads and with power-of-2 queue sizes
+static NF_TUNABLE bool VECTOR_PMD = false;
+
+// Whether to adapt the size of bursts to the load, from MIN_BURST_SIZE to
+// VIGOR_BATCH_SIZE, and to only transmit full bursts under load, unless they
+// have waited for TX_DRAIN_TIME
+static NF_TUNABLE bool ADAPTIVE_BURSTS = false;
+static NF_TUNABLE vigor_time_t TX_DRAIN_TIME = 100000; // 100us
+
+// Number of packets between the one whose headers are prefetched and the one
+// whose state is prefetched, see prefetch_burst; 0 disables prefetching headers
+static NF_TUNABLE uint16_t PREFETCH_DISTANCE = 4;
+
+// Vector PMDs cannot receive fewer packets at once
+static const uint16_t MIN_BURST_SIZE = VIGOR_BATCH_SIZE < 4 ? VIGOR_BATCH_SIZE : 4;
 #endif
 
-// Buffer count for mempools
-static const unsigned MEMPOOL_BUFFER_COUNT = 256;
+// Buffer count for mempools, per device and per queue; with VIGOR_BATCH_SIZE,
+// at least enough for the queues, see parse_tuning_options
+static NF_TUNABLE unsigned MEMPOOL_BUFFER_COUNT = 256;
+
+// Per-lcore cache size for the mempool, which all lcores share;
+// not useful in a single-threaded app
+#ifdef VIGOR_MULTICORE
+static NF_TUNABLE unsigned MEMPOOL_CACHE_SIZE = 32;
+#else // VIGOR_MULTICORE
+static NF_TUNABLE unsigned MEMPOOL_CACHE_SIZE = 0;
+#endif // VIGOR_MULTICORE
+
+#if defined(VIGOR_MULTICORE) || defined(VIGOR_RSS_HASH)
+// RSS key size to use if the driver does not tell us, 40 bytes is the usual
+static const uint8_t RSS_DEFAULT_KEY_SIZE = 40;
+#endif
 
 // Send the given packet to all devices except the packet's own
-void flood(struct rte_mbuf* packet, uint16_t nb_devices) {
+void flood(struct rte_mbuf* packet, uint16_t nb_devices, uint16_t queue) {
   rte_mbuf_refcnt_set(packet, nb_devices - 1);
   int total_sent = 0;
   uint16_t skip_device = packet->port;
   for (uint16_t device = 0; device < nb_devices; device++) {
     if (device != skip_device) {
-      total_sent += rte_eth_tx_burst(device, 0, &packet, 1);
+      total_sent += rte_eth_tx_burst(device, queue, &packet, 1);
     }
   }
   // should not happen, but in case we couldn't transmit, ensure the packet is freed
@@ -95,33 +146,148 @@ void flood(struct rte_mbuf* packet, uint16_t nb_devices) {
   }
 }
 
-// Initializes the given device using the given memory pool
-static int nf_init_device(uint16_t device, struct rte_mempool* mbuf_pool) {
+#if VIGOR_BATCH_SIZE != 1
+// Default batch processing, for NFs that only process one packet at a time
+__attribute__((weak))
+void nf_process_batch(uint16_t device, struct rte_mbuf** mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t* dst_devices) {
+  for (uint16_t n = 0; n < count; n++) {
+    uint8_t* data = rte_pktmbuf_mtod(mbufs[n], uint8_t*);
+    packet_state_total_length(data, &(mbufs[n]->pkt_len));
+    dst_devices[n] = nf_process(device, data, mbufs[n]->pkt_len, now);
+    nf_return_all_chunks(data);
+  }
+}
+
+// Default maintenance, for NFs that do it while processing packets
+__attribute__((weak))
+void nf_tick(vigor_time_t now) {
+  (void) now;
+}
+
+// Default prefetching, for NFs whose state is not worth prefetching
+__attribute__((weak))
+void nf_prefetch(uint16_t device, struct rte_mbuf* mbuf, uint16_t n) {
+  (void) device;
+  (void) mbuf;
+  (void) n;
+}
+
+// Prefetches the headers of the given packets, and lets the NF parse them and
+// prefetch their state PREFETCH_DISTANCE packets later, once their headers have
+// arrived; the driver has just written the metadata of the mbufs, so it is
+// already cached
+static inline void prefetch_burst(uint16_t device, struct rte_mbuf** mbufs,
+                                  uint16_t count) {
+  for (unsigned n = 0; n < count + PREFETCH_DISTANCE; n++) {
+    if (n < count && PREFETCH_DISTANCE != 0) {
+      rte_prefetch0(rte_pktmbuf_mtod(mbufs[n], void*));
+    }
+    if (n >= PREFETCH_DISTANCE) {
+      nf_prefetch(device, mbufs[n - PREFETCH_DISTANCE],
+                  n - PREFETCH_DISTANCE);
+    }
+  }
+}
+
+// Transmits the packets buffered for the given device
+static inline void flush_tx(uint16_t device, uint16_t queue,
+                            struct rte_mbuf** buffer, uint16_t* count) {
+  uint16_t sent_count = rte_eth_tx_burst(device, queue, buffer, *count);
+  // should not happen, but we're in the unverified case anyway
+  rte_pktmbuf_free_bulk(buffer + sent_count, *count - sent_count);
+  *count = 0;
+}
+
+// Buffers the given packet for transmission on the given device,
+// transmitting the buffer first if it is full
+static inline void buffer_tx(uint16_t device, uint16_t queue,
+                             struct rte_mbuf** buffer, uint16_t* count,
+                             struct rte_mbuf* packet) {
+  if (*count == VIGOR_BATCH_SIZE) {
+    flush_tx(device, queue, buffer, count);
+  }
+  buffer[*count] = packet;
+  (*count)++;
+}
+#endif
+
+// Initializes the given device using the given memory pool,
+// with the given number of RX/TX queues
+static int nf_init_device(uint16_t device, struct rte_mempool* mbuf_pool,
+                          uint16_t nb_queues) {
   int retval;
 
   // device_conf passed to rte_eth_dev_configure cannot be NULL
   struct rte_eth_conf device_conf = {0};
   //device_conf.rxmode.hw_strip_crc = 1;
 
-  // Configure the device (1, 1 == number of RX/TX queues)
-  retval = rte_eth_dev_configure(device, 1, 1, &device_conf);
+#if defined(VIGOR_MULTICORE) || defined(VIGOR_RSS_HASH) || VIGOR_BATCH_SIZE != 1
+  struct rte_eth_dev_info dev_info;
+  retval = rte_eth_dev_info_get(device, &dev_info);
   if (retval != 0) {
     return retval;
   }
+#endif
+
+#if VIGOR_BATCH_SIZE != 1
+  // Let the device compute checksums on transmission if it can,
+  // see nf_offload_rte_ipv4_udptcp_checksum
+  uint64_t cksum_offloads = DEV_TX_OFFLOAD_IPV4_CKSUM |
+                            DEV_TX_OFFLOAD_TCP_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM;
+  nf_tx_cksum_offload[device] =
+      !VECTOR_PMD &&
+      (dev_info.tx_offload_capa & cksum_offloads) == cksum_offloads;
+  if (nf_tx_cksum_offload[device]) {
+    device_conf.txmode.offloads |= cksum_offloads;
+    NF_INFO("Device %" PRIu16 " computes checksums on transmission.", device);
+  }
+#endif
+
+#if defined(VIGOR_MULTICORE) || defined(VIGOR_RSS_HASH)
+  // Spread flows across queues, keeping both directions of a flow together;
+  // with VIGOR_RSS_HASH, even with a single queue, to get the hashes
+  uint8_t rss_key[UINT8_MAX];
+#  ifdef VIGOR_RSS_HASH
+  bool use_rss = true;
+#  else // VIGOR_RSS_HASH
+  bool use_rss = nb_queues > 1;
+#  endif // VIGOR_RSS_HASH
+  if (use_rss) {
+    uint8_t rss_key_size = dev_info.hash_key_size == 0 ?
+                           RSS_DEFAULT_KEY_SIZE : dev_info.hash_key_size;
+    rss_fill_symmetric_key(rss_key, rss_key_size);
+    device_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+    device_conf.rx_adv_conf.rss_conf.rss_key = rss_key;
+    device_conf.rx_adv_conf.rss_conf.rss_key_len = rss_key_size;
+    device_conf.rx_adv_conf.rss_conf.rss_hf =
+        (ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+  }
+#endif // VIGOR_MULTICORE || VIGOR_RSS_HASH
 
-  // Allocate and set up a TX queue (NULL == default config)
-  retval = rte_eth_tx_queue_setup(device, 0, TX_QUEUE_SIZE,
-                                  rte_eth_dev_socket_id(device), NULL);
+  // Configure the device (same number of RX and TX queues)
+  retval = rte_eth_dev_configure(device, nb_queues, nb_queues, &device_conf);
   if (retval != 0) {
     return retval;
   }
 
+  // Allocate and set up TX queues (NULL == default config)
+  for (uint16_t queue = 0; queue < nb_queues; queue++) {
+    retval = rte_eth_tx_queue_setup(device, queue, TX_QUEUE_SIZE,
+                                    rte_eth_dev_socket_id(device), NULL);
+    if (retval != 0) {
+      return retval;
+    }
+  }
+
   // Allocate and set up RX queues (NULL == default config)
-  retval = rte_eth_rx_queue_setup(device, 0, RX_QUEUE_SIZE,
-                                  rte_eth_dev_socket_id(device),
-                                  NULL, mbuf_pool);
-  if (retval != 0) {
-    return retval;
+  for (uint16_t queue = 0; queue < nb_queues; queue++) {
+    retval = rte_eth_rx_queue_setup(device, queue, RX_QUEUE_SIZE,
+                                    rte_eth_dev_socket_id(device),
+                                    NULL, mbuf_pool);
+    if (retval != 0) {
+      return retval;
+    }
   }
 
   // Start the device
@@ -130,6 +296,45 @@ static int nf_init_device(uint16_t device, struct rte_mempool* mbuf_pool) {
     return retval;
   }
 
+#ifdef VIGOR_RSS_HASH
+  // Only reuse the device's hashes if it kept the symmetric key, without which
+  // they differ from rss_hash_ipv4, and hashes TCP/UDP packets with their
+  // ports; nf_rss_hash also checks the first hashes of each lcore
+  struct rte_eth_rss_conf* rss_conf = &device_conf.rx_adv_conf.rss_conf;
+  uint8_t used_rss_key[UINT8_MAX];
+  struct rte_eth_rss_conf used_rss_conf = {
+    .rss_key = used_rss_key,
+    .rss_key_len = rss_conf->rss_key_len,
+  };
+  uint64_t flow_hashes = ETH_RSS_NONFRAG_IPV4_TCP | ETH_RSS_NONFRAG_IPV4_UDP;
+  nf_rx_rss_hash[device] =
+      rte_eth_dev_rss_hash_conf_get(device, &used_rss_conf) == 0 &&
+      used_rss_conf.rss_key_len == rss_conf->rss_key_len &&
+      memcmp(used_rss_key, rss_conf->rss_key, rss_conf->rss_key_len) == 0 &&
+      (used_rss_conf.rss_hf & flow_hashes) == flow_hashes;
+  if (nf_rx_rss_hash[device]) {
+    NF_INFO("Device %" PRIu16 " computes RSS hashes.", device);
+  }
+#endif // VIGOR_RSS_HASH
+
+#if VIGOR_BATCH_SIZE != 1
+  // Let NFs use the packet types the device finds if it classifies IPv4 TCP/UDP,
+  // see nf_packet_type; this depends on the RX function, thus on the start
+  uint32_t ptypes[64];
+  int ptypes_count = rte_eth_dev_get_supported_ptypes(
+      device, NF_PTYPE_MASK, ptypes, RTE_DIM(ptypes));
+  bool ipv4 = false, tcp = false, udp = false;
+  for (int n = 0; n < RTE_MIN(ptypes_count, (int) RTE_DIM(ptypes)); n++) {
+    ipv4 |= RTE_ETH_IS_IPV4_HDR(ptypes[n]);
+    tcp |= ptypes[n] == RTE_PTYPE_L4_TCP;
+    udp |= ptypes[n] == RTE_PTYPE_L4_UDP;
+  }
+  nf_rx_ptypes[device] = ipv4 && tcp && udp;
+  if (nf_rx_ptypes[device]) {
+    NF_INFO("Device %" PRIu16 " classifies packets.", device);
+  }
+#endif
+
   // Enable RX in promiscuous mode, just in case
   rte_eth_promiscuous_enable(device);
   if (rte_eth_promiscuous_get(device) != 1) {
@@ -139,18 +344,28 @@ static int nf_init_device(uint16_t device, struct rte_mempool* mbuf_pool) {
   return 0;
 }
 
-// Main worker method (for now used on a single thread...)
-static void worker_main(void) {
+// Main worker method, run on every lcore with VIGOR_MULTICORE,
+// on a single thread otherwise
+static int worker_main(void* unused) {
+  (void) unused;
+
   if (!nf_init()) {
     rte_exit(EXIT_FAILURE, "Error initializing NF");
   }
 
-  NF_INFO("Core %u forwarding packets.", rte_lcore_id());
+  // Each lcore has its own queue on every device
+#ifdef VIGOR_MULTICORE
+  uint16_t queue = rte_lcore_index(rte_lcore_id());
+#else // VIGOR_MULTICORE
+  uint16_t queue = 0;
+#endif // VIGOR_MULTICORE
+
+  NF_INFO("Core %u forwarding packets on queue %" PRIu16 ".", rte_lcore_id(), queue);
 
 #if VIGOR_BATCH_SIZE == 1
   VIGOR_LOOP_BEGIN
     struct rte_mbuf* mbuf;
-    if (rte_eth_rx_burst(VIGOR_DEVICE, 0, &mbuf, 1) != 0) {
+    if (rte_eth_rx_burst(VIGOR_DEVICE, queue, &mbuf, 1) != 0) {
       uint8_t* data = rte_pktmbuf_mtod(mbuf, uint8_t*);
       packet_state_total_length(data, &(mbuf->pkt_len));
       uint16_t dst_device = nf_process(mbuf->port, data, mbuf->pkt_len, VIGOR_NOW);
@@ -159,11 +374,11 @@ static void worker_main(void) {
       if (dst_device == VIGOR_DEVICE) {
         rte_pktmbuf_free(mbuf);
       } else if (dst_device == FLOOD_FRAME) {
-        flood(mbuf, VIGOR_DEVICES_COUNT);
+        flood(mbuf, VIGOR_DEVICES_COUNT, queue);
       } else {
         // ensure we don't leak symbols into DPDK
         concretize_devices(&dst_device, rte_eth_dev_count_avail());
-        if (rte_eth_tx_burst(dst_device, 0, &mbuf, 1) != 1) {
+        if (rte_eth_tx_burst(dst_device, queue, &mbuf, 1) != 1) {
 #ifdef VIGOR_ALLOW_DROPS
           rte_pktmbuf_free(mbuf); // OK, we're debugging
 #else
@@ -177,45 +392,184 @@ static void worker_main(void) {
 
 #else // if VIGOR_BATCH_SIZE != 1
 
-  if (rte_eth_dev_count() != 2) {
-    printf("We assume there will be exactly 2 devices for our simple batching implementation.");
-    exit(1);
-  }
   NF_INFO("Running with batches, this code is unverified!");
 
+  unsigned nb_devices = rte_eth_dev_count_avail();
+  // Packets to transmit on each device, flushed once per round of polling all
+  // devices or when full, so that flooding the packets of several small bursts
+  // costs one transmission per device instead of one per burst and device
+  struct rte_mbuf* mbufs_to_send[nb_devices][VIGOR_BATCH_SIZE];
+  uint16_t tx_counts[nb_devices];
+  memset(tx_counts, 0, sizeof(tx_counts));
+
+  // Number of packets to receive at once from each device, which with
+  // ADAPTIVE_BURSTS doubles when the device fills a burst, i.e., when its queue
+  // builds up, and halves when it fills less than half of it
+  uint16_t burst_sizes[nb_devices];
+  for (uint16_t device = 0; device < nb_devices; device++) {
+    burst_sizes[device] = ADAPTIVE_BURSTS ? MIN_BURST_SIZE : VIGOR_BATCH_SIZE;
+  }
+  vigor_time_t last_flush_time = 0;
+
   while(1) {
-    unsigned VIGOR_DEVICES_COUNT = rte_eth_dev_count();
-    for (uint16_t VIGOR_DEVICE = 0; VIGOR_DEVICE < VIGOR_DEVICES_COUNT; VIGOR_DEVICE++) {
+    vigor_time_t round_time = current_time();
+    nf_tick(round_time);
+
+    // Whether a device filled its burst, in which case adaptive bursts only
+    // transmit full buffers, or those that waited too long
+    bool loaded = false;
+
+    for (uint16_t VIGOR_DEVICE = 0; VIGOR_DEVICE < nb_devices; VIGOR_DEVICE++) {
       struct rte_mbuf* mbufs[VIGOR_BATCH_SIZE];
-      uint16_t rx_count = rte_eth_rx_burst(VIGOR_DEVICE, 0, mbufs, VIGOR_BATCH_SIZE);
+      uint16_t burst_size = burst_sizes[VIGOR_DEVICE];
+      uint16_t rx_count = rte_eth_rx_burst(VIGOR_DEVICE, queue, mbufs, burst_size);
+
+      if (ADAPTIVE_BURSTS) {
+        if (rx_count == burst_size) {
+          loaded = true;
+          burst_sizes[VIGOR_DEVICE] = RTE_MIN(2 * burst_size, VIGOR_BATCH_SIZE);
+        } else if (rx_count < burst_size / 2) {
+          burst_sizes[VIGOR_DEVICE] = RTE_MAX(burst_size / 2, MIN_BURST_SIZE);
+        }
+      }
+
+      if (rx_count == 0) {
+        continue;
+      }
+
+      vigor_time_t VIGOR_NOW = current_time();
+      prefetch_burst(VIGOR_DEVICE, mbufs, rx_count);
+      uint16_t dst_devices[VIGOR_BATCH_SIZE];
+      nf_process_batch(VIGOR_DEVICE, mbufs, rx_count, VIGOR_NOW, dst_devices);
 
-      struct rte_mbuf *mbufs_to_send[VIGOR_BATCH_SIZE];
-      uint16_t tx_count = 0;
+      struct rte_mbuf* mbufs_to_drop[VIGOR_BATCH_SIZE];
+      uint16_t drop_count = 0;
       for (uint16_t n = 0; n < rx_count; n++) {
-        uint8_t* data = rte_pktmbuf_mtod(mbufs[n], uint8_t*);
-        packet_state_total_length(data, &(mbufs[n]->pkt_len));
-        vigor_time_t VIGOR_NOW = current_time();
-        uint16_t dst_device = nf_process(mbufs[n]->port, data, mbufs[n]->pkt_len, VIGOR_NOW);
-        nf_return_all_chunks(data);
-
-        if (dst_device == VIGOR_DEVICE) {
-          rte_pktmbuf_free(mbufs[n]);
-        } else { // includes flood when 2 devices, which is equivalent to just a send
-          mbufs_to_send[tx_count] = mbufs[n];
-          tx_count++;
-       }
-     }
-
-      uint16_t sent_count = rte_eth_tx_burst(1 - VIGOR_DEVICE, 0, mbufs_to_send, tx_count);
-      for (uint16_t n = sent_count; n < tx_count; n++) {
-        rte_pktmbuf_free(mbufs[n]); // should not happen, but we're in the unverified case anyway
+        uint16_t dst_device = dst_devices[n];
+        if (dst_device == VIGOR_DEVICE || (dst_device == FLOOD_FRAME && nb_devices == 1)) {
+          mbufs_to_drop[drop_count] = mbufs[n];
+          drop_count++;
+        } else if (dst_device == FLOOD_FRAME) {
+          // The same mbuf is sent on every other device, and freed by the last one
+          rte_mbuf_refcnt_set(mbufs[n], nb_devices - 1);
+          for (uint16_t device = 0; device < nb_devices; device++) {
+            if (device != VIGOR_DEVICE) {
+              buffer_tx(device, queue, mbufs_to_send[device], &tx_counts[device], mbufs[n]);
+            }
+          }
+        } else if (dst_device >= nb_devices) {
+          // Verification proves NFs never do this, but the batched build is not
+          // verified, and must not write past mbufs_to_send
+          NF_DEBUG("Dropping packet sent to unknown device %" PRIu16, dst_device);
+          mbufs_to_drop[drop_count] = mbufs[n];
+          drop_count++;
+        } else {
+          buffer_tx(dst_device, queue, mbufs_to_send[dst_device], &tx_counts[dst_device], mbufs[n]);
+        }
+      }
+
+      rte_pktmbuf_free_bulk(mbufs_to_drop, drop_count);
+    }
+
+    if (loaded && round_time - last_flush_time < TX_DRAIN_TIME) {
+      continue;
+    }
+    for (uint16_t device = 0; device < nb_devices; device++) {
+      if (tx_counts[device] != 0) {
+        flush_tx(device, queue, mbufs_to_send[device], &tx_counts[device]);
       }
     }
+    last_flush_time = round_time;
   }
 #endif
+
+  return 0;
 }
 
 
+#if VIGOR_BATCH_SIZE != 1
+// Parses the value of the tuning option at argv[*n], moving n past it
+static unsigned parse_tuning_value(int argc, char** argv, int* n,
+                                   uintmax_t min, uintmax_t max) {
+  const char* name = argv[*n];
+  (*n)++;
+  if (*n == argc) {
+    rte_exit(EXIT_FAILURE, "Missing value for %s\n", name);
+  }
+  uintmax_t value = nf_util_parse_int(argv[*n], name, 10, '\0');
+  if (value < min || value > max) {
+    rte_exit(EXIT_FAILURE, "%s must be between %ju and %ju, not %ju\n", name,
+             min, max, value);
+  }
+  return value;
+}
+
+// Removes the device tuning options from the given NF arguments, leaving the
+// NF's own options to nf_config_init, and applies them
+static void parse_tuning_options(int* argc, char** argv) {
+  int kept = 1; // the program name
+  for (int n = 1; n < *argc; n++) {
+    if (strcmp(argv[n], "--rx-descs") == 0) {
+      RX_QUEUE_SIZE = parse_tuning_value(*argc, argv, &n, 32, UINT16_MAX);
+    } else if (strcmp(argv[n], "--tx-descs") == 0) {
+      TX_QUEUE_SIZE = parse_tuning_value(*argc, argv, &n, 32, UINT16_MAX);
+    } else if (strcmp(argv[n], "--mbufs") == 0) {
+      MEMPOOL_BUFFER_COUNT = parse_tuning_value(*argc, argv, &n, 1, UINT16_MAX);
+    } else if (strcmp(argv[n], "--mbuf-cache") == 0) {
+      MEMPOOL_CACHE_SIZE =
+          parse_tuning_value(*argc, argv, &n, 0, RTE_MEMPOOL_CACHE_MAX_SIZE);
+    } else if (strcmp(argv[n], "--vector-pmd") == 0) {
+      VECTOR_PMD = true;
+    } else if (strcmp(argv[n], "--adaptive-bursts") == 0) {
+      ADAPTIVE_BURSTS = true;
+    } else if (strcmp(argv[n], "--tx-drain-us") == 0) {
+      TX_DRAIN_TIME = parse_tuning_value(*argc, argv, &n, 0, 1000000) * 1000;
+    } else if (strcmp(argv[n], "--prefetch") == 0) {
+      PREFETCH_DISTANCE =
+          parse_tuning_value(*argc, argv, &n, 0, VIGOR_BATCH_SIZE);
+    } else {
+      argv[kept] = argv[n];
+      kept++;
+    }
+  }
+  argv[kept] = NULL;
+  *argc = kept;
+
+  // Buffers of each queue fill its RX ring, and as many can be waiting in its
+  // TX ring, in a burst and in the cache; with fewer, the device drops packets
+  // for lack of buffers to receive them into
+  unsigned min_buffer_count = RX_QUEUE_SIZE + TX_QUEUE_SIZE + VIGOR_BATCH_SIZE +
+                              MEMPOOL_CACHE_SIZE;
+  if (MEMPOOL_BUFFER_COUNT < min_buffer_count) {
+    NF_INFO("Using %u mbufs per device and queue instead of %u, enough for "
+            "the descriptors, a burst and the cache.",
+            min_buffer_count, MEMPOOL_BUFFER_COUNT);
+    MEMPOOL_BUFFER_COUNT = min_buffer_count;
+  }
+
+  NF_INFO("Devices use %" PRIu16 " RX and %" PRIu16 " TX descriptors, "
+          "%u mbufs per device and queue with a cache of %u, %s vector PMDs.",
+          RX_QUEUE_SIZE, TX_QUEUE_SIZE, MEMPOOL_BUFFER_COUNT,
+          MEMPOOL_CACHE_SIZE, VECTOR_PMD ? "with" : "without");
+  NF_INFO("Packets are prefetched %" PRIu16 " packets ahead.",
+          PREFETCH_DISTANCE);
+  if (ADAPTIVE_BURSTS) {
+    NF_INFO("Bursts adapt to the load, and wait at most %" PRIu64 "us.",
+            (uint64_t) TX_DRAIN_TIME / 1000);
+  }
+}
+
+// Gets the NUMA socket of the given device, or ours if it is unknown;
+// both can be SOCKET_ID_ANY, e.g. without NUMA, in which case it is socket 0
+static unsigned device_socket(uint16_t device) {
+  int socket = rte_eth_dev_socket_id(device);
+  if (socket < 0) {
+    socket = (int) rte_socket_id();
+  }
+  return socket < 0 || socket >= RTE_MAX_NUMA_NODES ? 0 : (unsigned) socket;
+}
+#endif
+
 // Entry point
 int MAIN(int argc, char** argv) {
   // Initialize the DPDK Environment Abstraction Layer (EAL)
@@ -226,16 +580,28 @@ int MAIN(int argc, char** argv) {
   argc -= ret;
   argv += ret;
 
+#if VIGOR_BATCH_SIZE != 1
+  parse_tuning_options(&argc, argv);
+#endif
+
   // NF-specific config
   nf_config_init(argc, argv);
   nf_config_print();
 
-  // Create a memory pool
+  // One RX/TX queue per lcore on every device
+#ifdef VIGOR_MULTICORE
+  uint16_t nb_queues = rte_lcore_count();
+#else // VIGOR_MULTICORE
+  uint16_t nb_queues = 1;
+#endif // VIGOR_MULTICORE
+
   unsigned nb_devices = rte_eth_dev_count_avail();
+#if VIGOR_BATCH_SIZE == 1
+  // Create a memory pool
   struct rte_mempool *mbuf_pool = rte_pktmbuf_pool_create(
       "MEMPOOL", // name
-      MEMPOOL_BUFFER_COUNT * nb_devices, // #elements
-      0, // cache size (per-core, not useful in a single-threaded app)
+      MEMPOOL_BUFFER_COUNT * nb_devices * nb_queues, // #elements
+      MEMPOOL_CACHE_SIZE, // cache size
       0, // application private area size
       RTE_MBUF_DEFAULT_BUF_SIZE, // data buffer size
       rte_socket_id()            // socket ID
@@ -243,10 +609,42 @@ int MAIN(int argc, char** argv) {
   if (mbuf_pool == NULL) {
     rte_exit(EXIT_FAILURE, "Cannot create pool: %s\n", rte_strerror(rte_errno));
   }
+#else // VIGOR_BATCH_SIZE
+  // Create a memory pool on every NUMA socket with devices,
+  // so that devices receive packets in local memory
+  unsigned socket_devices[RTE_MAX_NUMA_NODES] = {0};
+  for (uint16_t device = 0; device < nb_devices; device++) {
+    socket_devices[device_socket(device)]++;
+  }
+  struct rte_mempool *mbuf_pools[RTE_MAX_NUMA_NODES] = {NULL};
+  for (unsigned socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+    if (socket_devices[socket] == 0) {
+      continue;
+    }
+    char name[RTE_MEMPOOL_NAMESIZE];
+    snprintf(name, sizeof(name), "MEMPOOL_%u", socket);
+    mbuf_pools[socket] = rte_pktmbuf_pool_create(
+        name, // name
+        MEMPOOL_BUFFER_COUNT * socket_devices[socket] * nb_queues, // #elements
+        MEMPOOL_CACHE_SIZE, // cache size
+        0, // application private area size
+        RTE_MBUF_DEFAULT_BUF_SIZE, // data buffer size
+        socket                     // socket ID
+    );
+    if (mbuf_pools[socket] == NULL) {
+      rte_exit(EXIT_FAILURE, "Cannot create pool on socket %u: %s\n", socket,
+               rte_strerror(rte_errno));
+    }
+  }
+#endif // VIGOR_BATCH_SIZE
 
   // Initialize all devices
   for (uint16_t device = 0; device < nb_devices; device++) {
-    ret = nf_init_device(device, mbuf_pool);
+#if VIGOR_BATCH_SIZE == 1
+    ret = nf_init_device(device, mbuf_pool, nb_queues);
+#else // VIGOR_BATCH_SIZE
+    ret = nf_init_device(device, mbuf_pools[device_socket(device)], nb_queues);
+#endif // VIGOR_BATCH_SIZE
     if (ret == 0) {
       NF_INFO("Initialized device %" PRIu16 ".", device);
     } else {
@@ -255,7 +653,12 @@ int MAIN(int argc, char** argv) {
   }
 
   // Run!
-  worker_main();
+#ifdef VIGOR_MULTICORE
+  rte_eal_mp_remote_launch(worker_main, NULL, CALL_MASTER);
+  rte_eal_mp_wait_lcore();
+#else // VIGOR_MULTICORE
+  worker_main(NULL);
+#endif // VIGOR_MULTICORE
 
   return 0;
 }
@@ -7,11 +7,49 @@
 
 #define FLOOD_FRAME ((uint16_t) -1)
 
+// Unverified support for batching, useful for performance comparisons
+#ifndef VIGOR_BATCH_SIZE
+#  define VIGOR_BATCH_SIZE 1
+#endif
+
 struct nf_config;
+struct rte_mbuf;
 
+// With the unverified VIGOR_MULTICORE option, these are called on every lcore,
+// each of which processes the packets of its own RX queue on every device:
+// queue i is handled by the lcore whose rte_lcore_index is i
 bool nf_init(void);
 int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_time_t now);
 
+#if VIGOR_BATCH_SIZE != 1
+// Processes a burst of at most VIGOR_BATCH_SIZE packets received on the given
+// device, writing the destination of each packet in dst_devices, with the same
+// meaning as the result of nf_process.
+// NFs may define it to amortize work across packets, e.g. by parsing all
+// headers before looking up all flows; by default, it calls nf_process.
+void nf_process_batch(uint16_t device, struct rte_mbuf** mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t* dst_devices);
+
+// Called once per round of polling all devices, even if no packet arrived, for
+// maintenance such as expiring flows; by default, it does nothing.
+// NFs that expire entries here do so out of nf_process_batch, and at most
+// VIGOR_EXPIRATION_BUDGET entries per call, so that a mass timeout is spread
+// over several rounds instead of delaying a single burst; entries may thus
+// outlive their expiration time by a few rounds.
+void nf_tick(vigor_time_t now);
+
+// Called on each packet of a burst, in order, before nf_process_batch, with the
+// index of the packet in the burst, so that NFs can parse it and prefetch the
+// state they will look up for it, e.g. with map_prefetch_hashed, and keep what
+// they found for nf_process_batch; the headers of the packet were prefetched a
+// few packets earlier, see the --prefetch option. By default, it does nothing.
+void nf_prefetch(uint16_t device, struct rte_mbuf* mbuf, uint16_t n);
+
+#  ifndef VIGOR_EXPIRATION_BUDGET
+#    define VIGOR_EXPIRATION_BUDGET 64
+#  endif
+#endif
+
 extern struct nf_config config;
 void nf_config_init(int argc, char **argv);
 void nf_config_usage(void);
@@ -55,6 +55,16 @@ let containers = ["example_value", UInt32;]
    === *)
 let constraints = []
 
+(* ===
+   `record_groups` lists groups of vectors, and at most one DChain, that have
+   the same capacity and are indexed alike, e.g. by the DChain. With the
+   unverified VIGOR_VECTOR=records option, the elements of the same index in
+   a group are stored together in one record, and so are the timestamps of the
+   DChain with VIGOR_DCHAIN=lazy, so that accessing all of them touches a
+   single cache line. Each group is a list of container names.
+   === *)
+let record_groups = []
+
 (* ===
 
    Leave these definition as is, they will be filled automatically
@@ -19,6 +19,8 @@ bool nf_init(void) {
   // ===
   // Initialize your NF here, e.g. non-configuration global variables
   // You must at least allocate the state.
+  // With VIGOR_MULTICORE, this is called once per lcore, so mutable globals
+  // must be declared with VIGOR_LCORE_LOCAL.
   // ===
   return alloc_state(42) != NULL;
 }
@@ -0,0 +1,203 @@
+// Checks the checksum functions of nf-util.c that the unverified batched build
+// uses instead of nf_set_rte_ipv4_udptcp_checksum, on random TCP and UDP
+// packets whose addresses and ports are rewritten like the NAT and the load
+// balancer do:
+// - nf_update_rte_ipv4_udptcp_checksum, which adjusts the checksums for the
+//   rewritten fields only (RFC 1624);
+// - nf_offload_rte_ipv4_udptcp_checksum, which prepares packets for devices
+//   that compute checksums, whose work is done here in software.
+// Receivers only check that checksums sum to 0xffff along with the data they
+// cover, so the results are checked that way, except that a zero UDP checksum
+// means there is none, and must stay zero, and only then.
+// See the Makefile in this directory to run it.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netinet/in.h>
+
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "nf-util.h"
+
+#define PACKET_COUNT (1 << 20)
+#define MAX_PAYLOAD_SIZE 1460
+
+struct packet {
+  struct rte_ipv4_hdr ip;
+  union {
+    struct rte_tcp_hdr tcp;
+    struct rte_udp_hdr udp;
+  } l4;
+  uint8_t payload[MAX_PAYLOAD_SIZE];
+} __attribute__((__packed__));
+
+static unsigned failures = 0;
+
+static void check(bool ok, const char *what, unsigned n) {
+  if (!ok) {
+    if (failures < 10) {
+      printf("Packet %u: %s\n", n, what);
+    }
+    failures++;
+  }
+}
+
+static uint32_t random_u32(void) {
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static uint16_t l4_size(struct packet *packet) {
+  return rte_be_to_cpu_16(packet->ip.total_length) - sizeof(packet->ip);
+}
+
+static uint16_t get_l4_cksum(struct packet *packet) {
+  return packet->ip.next_proto_id == IPPROTO_TCP ? packet->l4.tcp.cksum
+                                                 : packet->l4.udp.dgram_cksum;
+}
+
+static void set_l4_cksum(struct packet *packet, uint16_t cksum) {
+  if (packet->ip.next_proto_id == IPPROTO_TCP) {
+    packet->l4.tcp.cksum = cksum;
+  } else {
+    packet->l4.udp.dgram_cksum = cksum;
+  }
+}
+
+static bool ip_cksum_ok(struct packet *packet) {
+  return rte_raw_cksum(&packet->ip, sizeof(packet->ip)) == 0xffff;
+}
+
+static bool l4_cksum_ok(struct packet *packet) {
+  uint32_t sum = rte_raw_cksum(&packet->l4, l4_size(packet)) +
+                 rte_ipv4_phdr_cksum(&packet->ip, 0);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return sum == 0xffff;
+}
+
+static void random_packet(struct packet *packet, bool tcp, bool udp_cksum) {
+  uint16_t payload_size = rand() % (MAX_PAYLOAD_SIZE + 1);
+  uint16_t l4_header_size =
+      tcp ? sizeof(struct rte_tcp_hdr) : sizeof(struct rte_udp_hdr);
+  memset(packet, 0, sizeof(*packet));
+  packet->ip.version_ihl = RTE_IPV4_VHL_DEF;
+  packet->ip.total_length =
+      rte_cpu_to_be_16(sizeof(packet->ip) + l4_header_size + payload_size);
+  packet->ip.packet_id = random_u32();
+  packet->ip.time_to_live = 64;
+  packet->ip.next_proto_id = tcp ? IPPROTO_TCP : IPPROTO_UDP;
+  packet->ip.src_addr = random_u32();
+  packet->ip.dst_addr = random_u32();
+  if (tcp) {
+    packet->l4.tcp.src_port = random_u32();
+    packet->l4.tcp.dst_port = random_u32();
+    packet->l4.tcp.sent_seq = random_u32();
+    packet->l4.tcp.recv_ack = random_u32();
+    packet->l4.tcp.data_off = 5 << 4;
+    packet->l4.tcp.rx_win = random_u32();
+  } else {
+    packet->l4.udp.src_port = random_u32();
+    packet->l4.udp.dst_port = random_u32();
+    packet->l4.udp.dgram_len = rte_cpu_to_be_16(l4_header_size + payload_size);
+  }
+  uint8_t *l4_payload = (uint8_t *)&packet->l4 + l4_header_size;
+  for (uint16_t b = 0; b < payload_size; b++) {
+    l4_payload[b] = rand();
+  }
+
+  nf_set_rte_ipv4_udptcp_checksum(&packet->ip, (struct tcpudp_hdr *)&packet->l4,
+                                  packet);
+  if (!udp_cksum) {
+    packet->l4.udp.dgram_cksum = 0;
+  }
+}
+
+// Rewrites the source or destination address and port of the given packet,
+// and gives their old and new values
+static void rewrite(struct packet *packet, uint32_t *old_addr,
+                    uint32_t *new_addr, uint16_t *old_port,
+                    uint16_t *new_port) {
+  struct tcpudp_hdr *l4 = (struct tcpudp_hdr *)&packet->l4;
+  bool source = rand() % 2;
+  *old_addr = source ? packet->ip.src_addr : packet->ip.dst_addr;
+  *old_port = source ? l4->src_port : l4->dst_port;
+  // Sometimes leave a field alone, like the LB does with ports
+  *new_addr = rand() % 4 == 0 ? *old_addr : random_u32();
+  *new_port = rand() % 4 == 0 ? *old_port : (uint16_t)random_u32();
+  if (source) {
+    packet->ip.src_addr = *new_addr;
+    l4->src_port = *new_port;
+  } else {
+    packet->ip.dst_addr = *new_addr;
+    l4->dst_port = *new_port;
+  }
+}
+
+int main(void) {
+  srand(42);
+  unsigned zero_sums = 0;
+  for (unsigned n = 0; n < PACKET_COUNT; n++) {
+    bool tcp = rand() % 2;
+    bool udp_cksum = tcp || rand() % 8 != 0;
+    struct packet packet;
+    random_packet(&packet, tcp, udp_cksum);
+
+    // The incremental update
+    struct packet updated = packet;
+    uint32_t old_addr, new_addr;
+    uint16_t old_port, new_port;
+    rewrite(&updated, &old_addr, &new_addr, &old_port, &new_port);
+    struct packet rewritten = updated;
+    nf_update_rte_ipv4_udptcp_checksum(&updated.ip,
+                                       (struct tcpudp_hdr *)&updated.l4,
+                                       old_addr, new_addr, old_port, new_port);
+    check(ip_cksum_ok(&updated), "bad updated IPv4 checksum", n);
+    if (udp_cksum) {
+      check(get_l4_cksum(&updated) != 0 || tcp, "updated UDP checksum is zero",
+            n);
+      check(l4_cksum_ok(&updated), "bad updated L4 checksum", n);
+    } else {
+      check(get_l4_cksum(&updated) == 0, "absent UDP checksum was set", n);
+    }
+
+    // What the full computation gives for UDP checksums that sum to zero
+    nf_set_rte_ipv4_udptcp_checksum(&rewritten.ip,
+                                    (struct tcpudp_hdr *)&rewritten.l4,
+                                    &rewritten);
+    if (!tcp && udp_cksum && rewritten.l4.udp.dgram_cksum == 0xffff) {
+      zero_sums++;
+      check(updated.l4.udp.dgram_cksum == 0xffff,
+            "UDP checksum summing to zero is not 0xffff", n);
+    }
+
+    // The offload preparation, then the device's work
+    struct rte_mbuf mbuf;
+    memset(&mbuf, 0, sizeof(mbuf));
+    struct packet offloaded = packet;
+    nf_offload_rte_ipv4_udptcp_checksum(&mbuf, &offloaded.ip,
+                                        (struct tcpudp_hdr *)&offloaded.l4);
+    check(mbuf.l2_len == sizeof(struct rte_ether_hdr) &&
+          mbuf.l3_len == sizeof(offloaded.ip),
+          "bad header lengths for offloading", n);
+    check((mbuf.ol_flags & (PKT_TX_IPV4 | PKT_TX_IP_CKSUM)) ==
+              (PKT_TX_IPV4 | PKT_TX_IP_CKSUM) &&
+          (mbuf.ol_flags & PKT_TX_L4_MASK) ==
+              (tcp ? PKT_TX_TCP_CKSUM : PKT_TX_UDP_CKSUM),
+          "bad offload flags", n);
+    offloaded.ip.hdr_checksum = rte_ipv4_cksum(&offloaded.ip);
+    uint16_t l4_sum = ~rte_raw_cksum(&offloaded.l4, l4_size(&offloaded));
+    set_l4_cksum(&offloaded, !tcp && l4_sum == 0 ? 0xffff : l4_sum);
+    check(ip_cksum_ok(&offloaded), "bad offloaded IPv4 checksum", n);
+    check(l4_cksum_ok(&offloaded), "bad offloaded L4 checksum", n);
+  }
+
+  printf("%u packets, %u UDP checksums summing to zero, %u failures\n",
+         PACKET_COUNT, zero_sums, failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+// Checks a double chain against a reference model of exact expiry, with
+// random interleavings of allocations, rejuvenations, frees and expirations:
+// - indexes expired at time T must have been rejuvenated before T;
+// - after expiring at time T, no index rejuvenated before T may remain,
+//   or before T - VIGOR_DCHAIN_GRANULARITY with VIGOR_DCHAIN=lazy.
+// With VIGOR_DCHAIN, expirations also use random budgets, which must still
+// expire everything when retried, and half the rounds keep the timestamps in
+// records as vectors do, see dchain_allocate_in.
+// The double chain implementation is chosen at build time, see
+// Makefile.libvig.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libvig/verified/double-chain.h"
+#ifdef VIGOR_DCHAIN
+#  include "libvig/unverified/double-chain-ext.h"
+#endif//VIGOR_DCHAIN
+
+#ifndef VIGOR_DCHAIN_GRANULARITY
+#  define VIGOR_DCHAIN_GRANULARITY 0
+#endif
+
+#define ROUNDS 200
+#define OPS_PER_ROUND 200000
+#define INDEX_RANGE 512
+
+// Enough for any budget to expire all indexes, including the moves
+#define MAX_RETRIES (4 * INDEX_RANGE)
+
+#ifdef VIGOR_DCHAIN
+// Records with the timestamps in the middle, as vector-ext.h lays them out
+struct Record {
+  uint64_t before;
+  struct dchain_stamps stamps;
+  uint32_t after;
+};
+static struct Record records[INDEX_RANGE];
+#endif//VIGOR_DCHAIN
+
+// The reference model
+static bool allocated[INDEX_RANGE];
+static vigor_time_t rejuvenated[INDEX_RANGE];
+static int allocated_count;
+
+static unsigned failures = 0;
+
+static void check(bool ok, const char* what, unsigned round, unsigned op) {
+  if (!ok) {
+    if (failures < 10) {
+      printf("Round %u, operation %u: %s\n", round, op, what);
+    }
+    failures++;
+  }
+}
+
+// Expires all indexes that expire at the given time, as the expirator would,
+// in several calls when their budgets run out
+static void expire(struct DoubleChain* chain, vigor_time_t time,
+                   unsigned round, unsigned op) {
+  int index;
+#ifdef VIGOR_DCHAIN
+  int budget_max = rand() % 2 == 0 ? INT32_MAX : 1 + rand() % 8;
+  unsigned calls = 0;
+  for (;;) {
+    int budget = budget_max;
+    while (dchain_expire_one_index_budget(chain, &index, time, &budget)) {
+#else//VIGOR_DCHAIN
+  {
+    while (dchain_expire_one_index(chain, &index, time)) {
+#endif//VIGOR_DCHAIN
+      check(index >= 0 && index < INDEX_RANGE && allocated[index],
+            "expired an index that is not allocated", round, op);
+      check(rejuvenated[index] < time, "expired an index too early", round,
+            op);
+      allocated[index] = false;
+      allocated_count--;
+    }
+#ifdef VIGOR_DCHAIN
+    if (budget > 0) {
+      break;
+    }
+    if (++calls > MAX_RETRIES) {
+      check(false, "expiring does not progress", round, op);
+      break;
+    }
+#endif//VIGOR_DCHAIN
+  }
+
+  for (int i = 0; i < INDEX_RANGE; i++) {
+    check(!allocated[i] ||
+              rejuvenated[i] + VIGOR_DCHAIN_GRANULARITY >= time,
+          "did not expire an index", round, op);
+  }
+}
+
+static void run_round(unsigned round) {
+  struct DoubleChain* chain;
+  int ok;
+#ifdef VIGOR_DCHAIN
+  if (round % 2 == 0) {
+    ok = dchain_allocate_in(INDEX_RANGE, &records[0].stamps,
+                            sizeof(struct Record), &chain);
+  } else {
+    ok = dchain_allocate(INDEX_RANGE, &chain);
+  }
+#else//VIGOR_DCHAIN
+  ok = dchain_allocate(INDEX_RANGE, &chain);
+#endif//VIGOR_DCHAIN
+  if (!ok) {
+    check(false, "cannot allocate", round, 0);
+    return;
+  }
+  for (int i = 0; i < INDEX_RANGE; i++) {
+    allocated[i] = false;
+  }
+  allocated_count = 0;
+
+  vigor_time_t now = 1000000;
+  vigor_time_t expiration_time = 1 + rand() % 5000;
+  for (unsigned op = 0; op < OPS_PER_ROUND; op++) {
+    now += rand() % 7;
+    int index;
+    switch (rand() % 10) {
+      case 0:
+      case 1:
+      case 2:
+        if (dchain_allocate_new_index(chain, &index, now)) {
+          check(index >= 0 && index < INDEX_RANGE && !allocated[index],
+                "allocated an index twice", round, op);
+          allocated[index] = true;
+          allocated_count++;
+          rejuvenated[index] = now;
+        } else {
+          check(allocated_count == INDEX_RANGE, "cannot allocate a free index",
+                round, op);
+        }
+        break;
+      case 3:
+      case 4:
+      case 5:
+      case 6:
+        index = rand() % INDEX_RANGE;
+        check(dchain_rejuvenate_index(chain, index, now) == allocated[index],
+              "rejuvenated an index that is not allocated", round, op);
+        if (allocated[index]) {
+          rejuvenated[index] = now;
+        }
+        break;
+      case 7:
+        index = rand() % INDEX_RANGE;
+        if (allocated[index]) {
+          dchain_free_index(chain, index);
+          allocated[index] = false;
+          allocated_count--;
+        }
+        break;
+      default:
+        expire(chain, now - expiration_time, round, op);
+        break;
+    }
+  }
+}
+
+int main(void) {
+  srand(1);
+  for (unsigned round = 0; round < ROUNDS; round++) {
+    run_round(round);
+  }
+  printf("%u rounds, %u failures\n", ROUNDS, failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,368 @@
+// Checks a map implementation against a reference model, with random
+// interleavings of all the operations of map.h and map-ext.h, and of the
+// functions map-typed.h specializes per key type with VIGOR_MAP:
+// - on keys copied into the map and on keys kept by pointer;
+// - on capacities from 1 to 1024, or powers of 2 with CAPACITY_POW2, or
+//   only FIXED_CAPACITY, with which the specialized functions take the mask
+//   of the map as a constant, see MAP_TYPED_FUNCTIONS_FIXED;
+// - with a good hash, with hashes that only have a few values, and with all
+//   hashes equal, so that probe sequences wrap around the whole map.
+// The map implementation is chosen at build time, see Makefile.libvig.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvig/verified/map.h"
+#include "libvig/unverified/map-ext.h"
+#ifdef VIGOR_MAP
+#  include "libvig/unverified/map-typed.h"
+#endif//VIGOR_MAP
+
+#define ROUNDS 300
+#define MAX_CAPACITY 1024
+#define OPS_PER_SLOT 16
+
+// Keys copied into the maps that do so
+struct SmallKey {
+  uint32_t id;
+  uint16_t salt;
+  uint8_t pad;
+  uint8_t tag;
+};
+
+// Keys kept by pointer, since they are larger than MAP_INLINE_KEY_SIZE
+struct BigKey {
+  uint32_t id;
+  uint8_t bytes[28];
+};
+
+enum hash_mode { HASH_GOOD, HASH_FEW, HASH_SAME };
+
+static enum hash_mode hash_mode;
+static unsigned key_size;
+static unsigned failures = 0;
+
+static unsigned mode_hash(uint32_t id) {
+  uint32_t hash = id * 0x9e3779b1u;
+  hash ^= hash >> 15;
+  switch (hash_mode) {
+    case HASH_GOOD:
+      return hash;
+    case HASH_FEW:
+      return hash & 0x83;
+    default:
+      return 0x5a5a5a5a;
+  }
+}
+
+bool SmallKey_eq(void* a, void* b) {
+  return memcmp(a, b, sizeof(struct SmallKey)) == 0;
+}
+
+unsigned SmallKey_hash(void* key) {
+  return mode_hash(((struct SmallKey*)key)->id);
+}
+
+static bool BigKey_eq(void* a, void* b) {
+  return memcmp(a, b, sizeof(struct BigKey)) == 0;
+}
+
+static unsigned BigKey_hash(void* key) {
+  return mode_hash(((struct BigKey*)key)->id);
+}
+
+#ifdef VIGOR_MAP
+MAP_TYPED_DECLARATIONS(SmallKey)
+#  ifdef FIXED_CAPACITY
+MAP_TYPED_FUNCTIONS_FIXED(SmallKey, FIXED_CAPACITY)
+#  else//FIXED_CAPACITY
+MAP_TYPED_FUNCTIONS(SmallKey)
+#  endif//FIXED_CAPACITY
+#endif//VIGOR_MAP
+
+// The keys that a round may put, whose storage outlives the map since
+// map_put keeps pointers to them in maps that do not copy keys
+static union {
+  struct SmallKey small;
+  struct BigKey big;
+} keys[2 * MAX_CAPACITY];
+
+// The reference model
+static bool present[2 * MAX_CAPACITY];
+static int values[2 * MAX_CAPACITY];
+
+static void check(bool ok, const char* what, unsigned round, unsigned op) {
+  if (!ok) {
+    if (failures < 10) {
+      printf("Round %u, operation %u: %s\n", round, op, what);
+    }
+    failures++;
+  }
+}
+
+static void make_key(unsigned n) {
+  memset(&keys[n], 0, sizeof(keys[n]));
+  if (key_size == sizeof(struct SmallKey)) {
+    keys[n].small.id = n;
+    keys[n].small.salt = rand();
+    keys[n].small.tag = rand();
+  } else {
+    keys[n].big.id = n;
+    for (unsigned b = 0; b < sizeof(keys[n].big.bytes); b++) {
+      keys[n].big.bytes[b] = rand();
+    }
+  }
+}
+
+// A copy of a key, so that maps cannot rely on the address of the key they
+// are given, except for map_put and map_commit
+static void copy_key(unsigned n, void* copy) {
+  memcpy(copy, &keys[n], key_size);
+}
+
+static unsigned key_hash(void* key) {
+  return key_size == sizeof(struct SmallKey) ? SmallKey_hash(key)
+                                             : BigKey_hash(key);
+}
+
+// Whether to use the functions specialized for SmallKey
+static bool use_typed(void) {
+#ifdef VIGOR_MAP
+  return key_size == sizeof(struct SmallKey) && rand() % 2 == 0;
+#else//VIGOR_MAP
+  return false;
+#endif//VIGOR_MAP
+}
+
+static int do_get(struct Map* map, void* key, int* value_out) {
+  bool hashed = rand() % 2 == 0;
+  if (use_typed()) {
+#ifdef VIGOR_MAP
+    return hashed ? map_SmallKey_get_hashed(map, key, key_hash(key), value_out)
+                  : map_SmallKey_get(map, key, value_out);
+#endif//VIGOR_MAP
+  }
+  return hashed ? map_get_hashed(map, key, key_hash(key), value_out)
+                : map_get(map, key, value_out);
+}
+
+static void do_put(struct Map* map, void* key, int value) {
+  bool hashed = rand() % 2 == 0;
+  if (use_typed()) {
+#ifdef VIGOR_MAP
+    if (hashed) {
+      map_SmallKey_put_hashed(map, key, key_hash(key), value);
+    } else {
+      map_SmallKey_put(map, key, value);
+    }
+    return;
+#endif//VIGOR_MAP
+  }
+  if (hashed) {
+    map_put_hashed(map, key, key_hash(key), value);
+  } else {
+    map_put(map, key, value);
+  }
+}
+
+static void do_erase(struct Map* map, void* key, void** trash) {
+  bool hashed = rand() % 2 == 0;
+  if (use_typed()) {
+#ifdef VIGOR_MAP
+    if (hashed) {
+      map_SmallKey_erase_hashed(map, key, key_hash(key), trash);
+    } else {
+      map_SmallKey_erase(map, key, trash);
+    }
+    return;
+#endif//VIGOR_MAP
+  }
+  if (hashed) {
+    map_erase_hashed(map, key, key_hash(key), trash);
+  } else {
+    map_erase(map, key, trash);
+  }
+}
+
+static int do_get_or_reserve(struct Map* map, void* key, int* value_out,
+                             struct MapReservation* reservation) {
+  bool hashed = rand() % 2 == 0;
+  if (use_typed()) {
+#ifdef VIGOR_MAP
+    return hashed ? map_SmallKey_get_or_reserve_hashed(
+                        map, key, key_hash(key), value_out, reservation)
+                  : map_SmallKey_get_or_reserve(map, key, value_out,
+                                                reservation);
+#endif//VIGOR_MAP
+  }
+  return hashed ? map_get_or_reserve_hashed(map, key, key_hash(key),
+                                            value_out, reservation)
+                : map_get_or_reserve(map, key, value_out, reservation);
+}
+
+static void do_commit(struct Map* map, struct MapReservation* reservation,
+                      void* key, int value) {
+  if (use_typed()) {
+#ifdef VIGOR_MAP
+    map_SmallKey_commit(map, reservation, key, value);
+    return;
+#endif//VIGOR_MAP
+  }
+  map_commit(map, reservation, key, value);
+}
+
+static unsigned random_capacity(void) {
+#ifdef FIXED_CAPACITY
+  return FIXED_CAPACITY;
+#endif//FIXED_CAPACITY
+  unsigned capacity = 1 + rand() % MAX_CAPACITY;
+#ifdef CAPACITY_POW2
+  // The verified map only takes powers of 2 then
+  unsigned pow2 = 1;
+  while (pow2 * 2 <= capacity) {
+    pow2 *= 2;
+  }
+  capacity = pow2;
+#endif//CAPACITY_POW2
+  return capacity;
+}
+
+static void run_round(unsigned round) {
+  unsigned capacity = random_capacity();
+  unsigned key_count = 2 * capacity;
+  hash_mode = (enum hash_mode)(rand() % 3);
+  key_size = rand() % 2 == 0 ? sizeof(struct SmallKey) : sizeof(struct BigKey);
+
+  struct Map* map;
+  bool allocated = key_size == sizeof(struct SmallKey)
+                       ? map_allocate_sized(SmallKey_eq, SmallKey_hash,
+                                            key_size, capacity, &map)
+                       : map_allocate_sized(BigKey_eq, BigKey_hash, key_size,
+                                            capacity, &map);
+  if (!allocated) {
+    check(false, "cannot allocate", round, 0);
+    return;
+  }
+#ifdef VIGOR_MAP
+  check(map_mask(map) == MAP_CAPACITY_MASK(capacity),
+        "the mask differs from the one for the capacity", round, 0);
+#endif//VIGOR_MAP
+  for (unsigned n = 0; n < key_count; n++) {
+    make_key(n);
+    present[n] = false;
+  }
+  unsigned size = 0;
+
+  // Fill the map most of the time before churning, to reach high loads
+  unsigned fill = rand() % 2 == 0 ? capacity : rand() % (capacity + 1);
+  for (unsigned n = 0; n < fill; n++) {
+    values[n] = rand();
+    do_put(map, &keys[n], values[n]);
+    present[n] = true;
+    size++;
+  }
+
+  unsigned op_count = OPS_PER_SLOT * capacity;
+  for (unsigned op = 0; op < op_count; op++) {
+    unsigned n = rand() % key_count;
+    union {
+      struct SmallKey small;
+      struct BigKey big;
+    } key;
+    copy_key(n, &key);
+    int value = -1;
+
+    switch (rand() % 8) {
+      case 0:
+      case 1: {
+        int found = do_get(map, &key, &value);
+        check(found == present[n], "get found the wrong key", round, op);
+        check(!found || value == values[n], "get got a wrong value", round,
+              op);
+        break;
+      }
+      case 2:
+        if (!present[n] && size < capacity) {
+          values[n] = rand();
+          do_put(map, &keys[n], values[n]);
+          present[n] = true;
+          size++;
+        }
+        break;
+      case 3:
+      case 4:
+        if (present[n]) {
+          void* trash = NULL;
+          do_erase(map, &key, &trash);
+          check(trash != NULL && memcmp(trash, &key, key_size) == 0,
+                "erase gave back another key", round, op);
+          present[n] = false;
+          size--;
+        }
+        break;
+      case 5: {
+        struct MapReservation reservation;
+        int found = do_get_or_reserve(map, &key, &value, &reservation);
+        check(found == present[n], "reservation found the wrong key", round,
+              op);
+        check(!found || value == values[n], "reservation got a wrong value",
+              round, op);
+        if (!found && size < capacity) {
+          values[n] = rand();
+          do_commit(map, &reservation, &keys[n], values[n]);
+          present[n] = true;
+          size++;
+        }
+        break;
+      }
+      case 6: {
+        void* bulk_keys[MAP_BULK_MAX];
+        unsigned bulk_ns[MAP_BULK_MAX];
+        int bulk_values[MAP_BULK_MAX];
+        uint64_t found_mask;
+        unsigned count = 1 + rand() % MAP_BULK_MAX;
+        int expected = 0;
+        for (unsigned b = 0; b < count; b++) {
+          bulk_ns[b] = rand() % key_count;
+          bulk_keys[b] = &keys[bulk_ns[b]];
+          expected += present[bulk_ns[b]];
+        }
+        int found = map_get_bulk(map, bulk_keys, count, bulk_values,
+                                 &found_mask);
+        check(found == expected, "bulk get found the wrong count", round, op);
+        for (unsigned b = 0; b < count; b++) {
+          bool found_one = (found_mask >> b) & 1;
+          check(found_one == present[bulk_ns[b]],
+                "bulk get found the wrong key", round, op);
+          check(!found_one || bulk_values[b] == values[bulk_ns[b]],
+                "bulk get got a wrong value", round, op);
+        }
+        break;
+      }
+      default:
+        map_prefetch_hashed(map, key_hash(&key));
+        break;
+    }
+    check(map_size(map) == size, "wrong size", round, op);
+  }
+
+  // Everything must still be where it should be
+  for (unsigned n = 0; n < key_count; n++) {
+    int value;
+    int found = map_get(map, &keys[n], &value);
+    check(found == present[n] && (!found || value == values[n]),
+          "wrong contents at the end", round, op_count);
+  }
+}
+
+int main(void) {
+  srand(42);
+  for (unsigned round = 0; round < ROUNDS; round++) {
+    run_round(round);
+  }
+  printf("%u rounds, %u failures\n", ROUNDS, failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
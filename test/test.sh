@@ -0,0 +1,114 @@
+#!/bin/bash
+
+# Tests the libVig data structures against reference models, see
+# Makefile.libvig, and the checksum handling of the batched build:
+# - test/checksum.c, against full recomputations;
+# - the NAT on net_ring devices, which cannot compute checksums, to check that
+#   it falls back to software checksums;
+# - TCP and UDP traffic through the NAT on net_tap devices, which can, once
+#   with offloads and once with --vector-pmd, i.e. in software.
+
+set -euo pipefail
+
+SCRIPT_DIR=$(cd $(dirname ${BASH_SOURCE[0]}) && pwd)
+NAT_DIR="$SCRIPT_DIR/../vignat"
+
+LAN_MAC=02:00:00:00:00:01
+WAN_MAC=02:00:00:00:00:02
+
+function cleanup {
+  sudo killall nf 2>/dev/null || true
+  sudo killall iperf 2>/dev/null || true
+  sudo ip netns delete lan 2>/dev/null || true
+  sudo ip netns delete wan 2>/dev/null || true
+}
+trap cleanup EXIT
+
+
+function nat_args {
+  echo "--wan 0 --lan-dev 1 --extip 10.0.0.1 --expire 10000000" \
+       "--max-flows 65536 --starting-port 0" \
+       "--eth-dest 0,$WAN_MAC --eth-dest 1,$LAN_MAC"
+}
+
+function test_nat_ring {
+  LOG=$(sudo timeout 5 "$NAT_DIR/build/app/nf" \
+            --vdev "net_ring0" --vdev "net_ring1" \
+            --no-pci --no-shconf -- $(nat_args) 2>&1 || true)
+  if ! echo "$LOG" | grep -q "forwarding packets on queue"; then
+    echo "$LOG"
+    echo "The NAT did not start on net_ring devices"
+    exit 1
+  fi
+  if echo "$LOG" | grep -q "computes checksums"; then
+    echo "net_ring devices should not compute checksums"
+    exit 1
+  fi
+}
+
+function test_nat_tap {
+  NF_OPTIONS=$1
+
+  sudo "$NAT_DIR/build/app/nf" \
+        --vdev "net_tap0,iface=test_wan" \
+        --vdev "net_tap1,iface=test_lan" \
+        --no-pci --no-shconf -- $NF_OPTIONS $(nat_args) \
+        >/dev/null 2>/dev/null &
+  NF_PID=$!
+
+  while [ ! -f /sys/class/net/test_lan/tun_flags -o \
+          ! -f /sys/class/net/test_wan/tun_flags ]; do
+    echo "Waiting for NF to launch...";
+    sleep 1;
+  done
+  sleep 2
+
+  sudo ip netns add lan
+  sudo ip link set test_lan netns lan
+  sudo ip netns exec lan ip link set test_lan address $LAN_MAC
+  sudo ip netns exec lan ifconfig test_lan up 10.0.0.1
+
+  sudo ip netns add wan
+  sudo ip link set test_wan netns wan
+  sudo ip netns exec wan ip link set test_wan address $WAN_MAC
+  sudo ip netns exec wan ifconfig test_wan up 10.0.0.2
+
+  # The NAT does not answer ARP, and rewrites MAC addresses anyway
+  sudo ip netns exec lan arp -i test_lan -s 10.0.0.2 $WAN_MAC
+  sudo ip netns exec wan arp -i test_wan -s 10.0.0.1 $LAN_MAC
+
+  # Packets with bad checksums are dropped by the receiving kernel,
+  # so TCP does not get through and UDP gets no server report
+  sudo ip netns exec wan iperf -s >/dev/null &
+  sudo ip netns exec wan iperf -us >/dev/null &
+  sleep 1
+  sudo ip netns exec lan timeout 20 iperf -c 10.0.0.2 -t 5
+  sudo ip netns exec lan timeout 20 iperf -uc 10.0.0.2 -t 5 | \
+      tee /dev/stderr | grep -q "Server Report"
+
+  sudo killall iperf
+  sudo killall nf
+  wait $NF_PID 2>/dev/null || true
+
+  sudo ip netns delete lan
+  sudo ip netns delete wan
+}
+
+
+cd "$SCRIPT_DIR"
+make -f Makefile.libvig clean
+make -f Makefile.libvig -j$(nproc)
+
+make clean
+make -j$(nproc)
+./build/app/checksum
+
+cd "$NAT_DIR"
+make clean
+make EXTRA_CFLAGS="-DVIGOR_BATCH_SIZE=32" -j$(nproc)
+
+test_nat_ring
+test_nat_tap ""
+test_nat_tap "--vector-pmd"
+
+echo "Done."
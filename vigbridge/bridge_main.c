@@ -23,17 +23,29 @@
 #include "bridge_config.h"
 #include "state.h"
 
+#if VIGOR_BATCH_SIZE != 1
+// The batched build is unverified anyway, and can hash keys only once
+#  include "libvig/unverified/map-ext.h"
+#  include "libvig/unverified/expirator-ext.h"
+#endif
+
 struct nf_config config;
 
-struct State *mac_tables;
+VIGOR_LCORE_LOCAL struct State *mac_tables;
 
 int bridge_expire_entries(vigor_time_t time) {
   assert(time >= 0); // we don't support the past
   assert(sizeof(vigor_time_t) <= sizeof(uint64_t));
   uint64_t time_u = (uint64_t)time; // OK because of the two asserts
   vigor_time_t last_time = time_u - config.expiration_time * 1000; // us to ns
+#if VIGOR_BATCH_SIZE != 1
+  return expire_items_single_map_budget(mac_tables->dyn_heap,
+                                        mac_tables->dyn_keys, mac_tables->dyn_map,
+                                        last_time, VIGOR_EXPIRATION_BUDGET);
+#else
   return expire_items_single_map(mac_tables->dyn_heap, mac_tables->dyn_keys,
                                  mac_tables->dyn_map, last_time);
+#endif
 }
 
 int bridge_get_device(struct rte_ether_addr *dst, uint16_t src_device) {
@@ -65,7 +77,13 @@ void bridge_put_update_entry(struct rte_ether_addr *src, uint16_t src_device,
                              vigor_time_t time) {
   int index = -1;
   int hash = rte_ether_addr_hash(src);
+#if VIGOR_BATCH_SIZE != 1
+  struct MapReservation reservation;
+  int present =
+      map_get_or_reserve(mac_tables->dyn_map, src, &index, &reservation);
+#else
   int present = map_get(mac_tables->dyn_map, src, &index);
+#endif
   if (present) {
     dchain_rejuvenate_index(mac_tables->dyn_heap, index, time);
   } else {
@@ -81,7 +99,11 @@ void bridge_put_update_entry(struct rte_ether_addr *src, uint16_t src_device,
     vector_borrow(mac_tables->dyn_vals, index, (void **)&value);
     memcpy(key, src, sizeof(struct rte_ether_addr));
     value->device = src_device;
+#if VIGOR_BATCH_SIZE != 1
+    map_commit(mac_tables->dyn_map, &reservation, key, index);
+#else
     map_put(mac_tables->dyn_map, key, index);
+#endif
     // the other half of the key is in the map
     vector_return(mac_tables->dyn_keys, index, key);
     vector_return(mac_tables->dyn_vals, index, value);
@@ -288,3 +310,37 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t buffer_length, vigor_t
 
   return forward_to;
 }
+
+#if VIGOR_BATCH_SIZE != 1
+void nf_tick(vigor_time_t now) {
+  bridge_expire_entries(now);
+}
+
+void nf_process_batch(uint16_t device, struct rte_mbuf **mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t *dst_devices) {
+  // Parse all packets first...
+  struct rte_ether_hdr *rte_ether_headers[VIGOR_BATCH_SIZE];
+  for (uint16_t n = 0; n < count; n++) {
+    struct rte_ipv4_hdr *rte_ipv4_header;
+    struct tcpudp_hdr *tcpudp_header;
+    nf_get_headers(mbufs[n], &rte_ether_headers[n], &rte_ipv4_header,
+                   &tcpudp_header);
+  }
+
+  // ...then learn and look up all addresses, in order since packets may
+  // teach us the location of the next packets' destinations
+  for (uint16_t n = 0; n < count; n++) {
+    bridge_put_update_entry(&rte_ether_headers[n]->s_addr, device, now);
+
+    int forward_to = bridge_get_device(&rte_ether_headers[n]->d_addr, device);
+    if (forward_to == -1) {
+      dst_devices[n] = FLOOD_FRAME;
+    } else if (forward_to == -2) {
+      NF_DEBUG("filtered frame");
+      dst_devices[n] = device;
+    } else {
+      dst_devices[n] = forward_to;
+    }
+  }
+}
+#endif
@@ -22,5 +22,7 @@ let constraints = ["dyn_val_condition", ( "DynamicValue",
                                             Bop (Lt, {t=Unknown;v=Id "index"}, {t=Unknown;v=Int 2});
                                            ])]
 
+let record_groups = [["dyn_keys"; "dyn_vals"; "dyn_heap"]]
+
 let gen_custom_includes = ref []
 let gen_records = ref []
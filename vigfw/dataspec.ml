@@ -16,5 +16,7 @@ let constraints = ["int_dev_bounds", ( "uint32_t",
                                                t=Unknown};
                                          ])]
 
+let record_groups = [["fv"; "int_devices"; "heap"]]
+
 let gen_custom_includes = ref []
 let gen_records = ref []
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "flow.h.gen.h"
 #include "nf-util.h"
 #include "nf-log.h"
 #include "nf-parse.h"
@@ -57,12 +58,24 @@ void nf_config_init(int argc, char **argv) {
         }
         break;
 
-      case 'f':
-        config.max_flows = nf_util_parse_int(optarg, "max-flows", 10, '\0');
-        if (config.max_flows <= 0) {
+      case 'f': {
+        uintmax_t max_flows = nf_util_parse_int(optarg, "max-flows", 10, '\0');
+        if (max_flows == 0) {
           PARSE_ERROR("Flow table size must be strictly positive.\n");
         }
+        if (max_flows > NF_MAX_CAPACITY(sizeof(struct FlowId))) {
+          PARSE_ERROR("Flow table size must be at most %zu.\n",
+                      NF_MAX_CAPACITY(sizeof(struct FlowId)));
+        }
+#ifdef VIGOR_RSS_HASH
+        if (max_flows > RSS_FLOW_HASHES) {
+          PARSE_ERROR("Flow table size must be at most %d with RSS hashes.\n",
+                      RSS_FLOW_HASHES);
+        }
+#endif // VIGOR_RSS_HASH
+        config.max_flows = max_flows;
         break;
+      }
 
       case 'w':
         config.wan_device = nf_util_parse_int(optarg, "wan-dev", 10, '\0');
@@ -10,6 +10,13 @@
 #include "libvig/verified/vector.h"
 #include "libvig/verified/expirator.h"
 
+#include "nf.h"
+#if VIGOR_BATCH_SIZE != 1
+// The batched build is unverified anyway, and can hash keys only once
+#  include "libvig/unverified/map-ext.h"
+#  include "libvig/unverified/expirator-ext.h"
+#endif
+
 #include "state.h"
 
 struct FlowManager {
@@ -61,13 +68,95 @@ void flow_manager_allocate_or_refresh_flow(struct FlowManager *manager,
   vector_return(manager->state->int_devices, index, int_dev);
 }
 
+#if VIGOR_BATCH_SIZE != 1
+void flow_manager_allocate_or_refresh_flow_hashed(struct FlowManager *manager,
+                                                  struct FlowId *id,
+                                                  unsigned hash,
+                                                  uint32_t internal_device,
+                                                  vigor_time_t time) {
+  int index;
+  struct MapReservation reservation;
+#ifdef VIGOR_MAP
+  if (map_FlowId_get_or_reserve_hashed(manager->state->fm, id, hash, &index,
+                                       &reservation)) {
+#else//VIGOR_MAP
+  if (map_get_or_reserve_hashed(manager->state->fm, id, hash, &index,
+                                &reservation)) {
+#endif//VIGOR_MAP
+    dchain_rejuvenate_index(manager->state->heap, index, time);
+    return;
+  }
+  if (!dchain_allocate_new_index(manager->state->heap, &index, time)) {
+    // No luck, the flow table is full, but we can at least let the
+    // outgoing traffic out.
+    return;
+  }
+
+#ifdef STATE_STATIC_FV_RECORDS
+  // The records are at a fixed address, see state.h
+  struct FlowId *key = state_fv_at(index);
+  *state_int_devices_at(index) = internal_device;
+#else//STATE_STATIC_FV_RECORDS
+  struct FlowId *key = 0;
+  vector_borrow(manager->state->fv, index, (void **)&key);
+#endif//STATE_STATIC_FV_RECORDS
+  memcpy((void *)key, (void *)id, sizeof(struct FlowId));
+#ifdef VIGOR_MAP
+  map_FlowId_commit(manager->state->fm, &reservation, key, index);
+#else//VIGOR_MAP
+  map_commit(manager->state->fm, &reservation, key, index);
+#endif//VIGOR_MAP
+#ifndef STATE_STATIC_FV_RECORDS
+  vector_return(manager->state->fv, index, key);
+  uint32_t *int_dev;
+  vector_borrow(manager->state->int_devices, index, (void **)&int_dev);
+  *int_dev = internal_device;
+  vector_return(manager->state->int_devices, index, int_dev);
+#endif//STATE_STATIC_FV_RECORDS
+}
+
+bool flow_manager_get_refresh_flow_hashed(struct FlowManager *manager,
+                                          struct FlowId *id, unsigned hash,
+                                          vigor_time_t time,
+                                          uint32_t *internal_device) {
+  int index;
+#ifdef VIGOR_MAP
+  if (map_FlowId_get_hashed(manager->state->fm, id, hash, &index) == 0) {
+#else//VIGOR_MAP
+  if (map_get_hashed(manager->state->fm, id, hash, &index) == 0) {
+#endif//VIGOR_MAP
+    return false;
+  }
+#ifdef STATE_STATIC_FV_RECORDS
+  *internal_device = *state_int_devices_at(index);
+#else//STATE_STATIC_FV_RECORDS
+  uint32_t *int_dev;
+  vector_borrow(manager->state->int_devices, index, (void **)&int_dev);
+  *internal_device = *int_dev;
+  vector_return(manager->state->int_devices, index, int_dev);
+#endif//STATE_STATIC_FV_RECORDS
+  dchain_rejuvenate_index(manager->state->heap, index, time);
+  return true;
+}
+
+void flow_manager_prefetch_flow(struct FlowManager *manager, unsigned hash) {
+  map_prefetch_hashed(manager->state->fm, hash);
+}
+#endif
+
 void flow_manager_expire(struct FlowManager *manager, vigor_time_t time) {
   assert(time >= 0); // we don't support the past
   assert(sizeof(vigor_time_t) <= sizeof(uint64_t));
   uint64_t time_u = (uint64_t)time; // OK because of the two asserts
   vigor_time_t last_time = time_u - manager->expiration_time * 1000; // us to ns
+#if VIGOR_BATCH_SIZE != 1
+  expire_items_single_map_budget(manager->state->heap, manager->state->fv,
+                                 manager->state->fm, last_time,
+                                 VIGOR_EXPIRATION_BUDGET);
+#else
   expire_items_single_map(manager->state->heap, manager->state->fv,
                           manager->state->fm, last_time);
+#endif
 }
 
 bool flow_manager_get_refresh_flow(struct FlowManager *manager,
@@ -3,6 +3,7 @@
 
 #include "flow.h.gen.h"
 #include "libvig/verified/vigor-time.h"
+#include "nf.h"
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -22,4 +23,21 @@ bool flow_manager_get_refresh_flow(struct FlowManager *manager,
                                    struct FlowId *id, vigor_time_t time,
                                    uint32_t *internal_device);
 
+#if VIGOR_BATCH_SIZE != 1
+// The same as the above, with the hash of the flow ID already computed,
+// e.g. by nf_rss_hash
+void flow_manager_allocate_or_refresh_flow_hashed(struct FlowManager *manager,
+                                                  struct FlowId *id,
+                                                  unsigned hash,
+                                                  uint32_t internal_device,
+                                                  vigor_time_t time);
+bool flow_manager_get_refresh_flow_hashed(struct FlowManager *manager,
+                                          struct FlowId *id, unsigned hash,
+                                          vigor_time_t time,
+                                          uint32_t *internal_device);
+
+// Prefetches what the above look up first for a flow ID with the given hash
+void flow_manager_prefetch_flow(struct FlowManager *manager, unsigned hash);
+#endif
+
 #endif //_FLOWMANAGER_H_INCLUDED_
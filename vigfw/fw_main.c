@@ -9,7 +9,7 @@
 
 struct nf_config config;
 
-struct FlowManager *flow_manager;
+VIGOR_LCORE_LOCAL struct FlowManager *flow_manager;
 
 bool nf_init(void) {
   flow_manager = flow_manager_allocate(
@@ -78,3 +78,108 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_t
 
   return dst_device;
 }
+
+#if VIGOR_BATCH_SIZE != 1
+void nf_tick(vigor_time_t now) {
+  flow_manager_expire(flow_manager, now);
+}
+
+// Gets the ID of the flow of the given packet as seen from the internal
+// devices, i.e. that of the reply flow for packets from the external device,
+// and returns its hash
+static unsigned packet_flow_id(uint16_t device, struct rte_mbuf *mbuf,
+                               struct rte_ipv4_hdr *rte_ipv4_header,
+                               struct tcpudp_hdr *tcpudp_header,
+                               struct FlowId *id) {
+  if (device == config.wan_device) {
+    // Inverse the src and dst for the "reply flow"
+    *id = (struct FlowId){
+      .src_port = tcpudp_header->dst_port,
+      .dst_port = tcpudp_header->src_port,
+      .src_ip = rte_ipv4_header->dst_addr,
+      .dst_ip = rte_ipv4_header->src_addr,
+      .protocol = rte_ipv4_header->next_proto_id,
+    };
+  } else {
+    *id = (struct FlowId){
+      .src_port = tcpudp_header->src_port,
+      .dst_port = tcpudp_header->dst_port,
+      .src_ip = rte_ipv4_header->src_addr,
+      .dst_ip = rte_ipv4_header->dst_addr,
+      .protocol = rte_ipv4_header->next_proto_id,
+    };
+  }
+#ifdef VIGOR_RSS_HASH
+  // The same in both directions, thanks to symmetric RSS
+  return nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+#else
+  (void)mbuf;
+  return FlowId_hash(id);
+#endif
+}
+
+// What nf_prefetch finds in each packet of the current burst
+struct burst_packet {
+  struct rte_ether_hdr *rte_ether_header;
+  struct rte_ipv4_hdr *rte_ipv4_header;
+  struct tcpudp_hdr *tcpudp_header; // NULL if the packet is dropped
+  struct FlowId id;
+  unsigned hash;
+};
+static VIGOR_LCORE_LOCAL struct burst_packet burst[VIGOR_BATCH_SIZE];
+
+// Parses all packets first, as they arrive...
+void nf_prefetch(uint16_t device, struct rte_mbuf *mbuf, uint16_t n) {
+  struct burst_packet *packet = &burst[n];
+  // Packets the device knows are not IPv4 TCP/UDP are dropped unread
+  if (!nf_ptype_may_be_tcpudp(nf_packet_type(mbuf))) {
+    packet->tcpudp_header = NULL;
+    return;
+  }
+  nf_get_headers(mbuf, &packet->rte_ether_header, &packet->rte_ipv4_header,
+                 &packet->tcpudp_header);
+  if (packet->tcpudp_header != NULL) {
+    packet->hash = packet_flow_id(device, mbuf, packet->rte_ipv4_header,
+                                  packet->tcpudp_header, &packet->id);
+    flow_manager_prefetch_flow(flow_manager, packet->hash);
+  }
+}
+
+void nf_process_batch(uint16_t device, struct rte_mbuf **mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t *dst_devices) {
+  (void)mbufs;
+
+  // ...then look up all flows, in order since packets may allocate flows...
+  for (uint16_t n = 0; n < count; n++) {
+    struct burst_packet *packet = &burst[n];
+    dst_devices[n] = device;
+    if (packet->tcpudp_header == NULL) {
+      NF_DEBUG("Not IPv4 TCP/UDP, dropping");
+      continue;
+    }
+
+    if (device == config.wan_device) {
+      uint32_t dst_device_long;
+      if (!flow_manager_get_refresh_flow_hashed(flow_manager, &packet->id,
+                                                packet->hash, now,
+                                                &dst_device_long)) {
+        NF_DEBUG("Unknown external flow, dropping");
+        continue;
+      }
+      dst_devices[n] = dst_device_long;
+    } else {
+      flow_manager_allocate_or_refresh_flow_hashed(flow_manager, &packet->id,
+                                                   packet->hash, device, now);
+      dst_devices[n] = config.wan_device;
+    }
+  }
+
+  // ...and finally rewrite the packets we forward
+  for (uint16_t n = 0; n < count; n++) {
+    if (dst_devices[n] != device) {
+      burst[n].rte_ether_header->s_addr = config.device_macs[dst_devices[n]];
+      burst[n].rte_ether_header->d_addr = config.endpoint_macs[dst_devices[n]];
+    }
+  }
+}
+#endif
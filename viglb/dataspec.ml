@@ -46,5 +46,7 @@ let constraints = ["lb_backend_id_condition",
                      [Bop (Lt, {t=Unknown;v=Id "v"}, {t=Unknown;v=Int 32});
                      ])]
 
+let record_groups = [["flow_heap"; "flow_id_to_backend_id"; "flow_chain"]]
+
 let gen_custom_includes = ref []
 let gen_records = ref []
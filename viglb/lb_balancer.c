@@ -3,6 +3,12 @@
 
 #include "libvig/verified/map.h"
 #include "libvig/verified/expirator.h"
+#include "nf.h"
+
+#if VIGOR_BATCH_SIZE != 1
+// The batched build is unverified anyway, and expires entries in nf_tick
+#  include "libvig/unverified/expirator-ext.h"
+#endif
 
 #include <rte_ethdev.h>
 
@@ -41,7 +47,12 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
                                           uint16_t wan_device) {
   int flow_index;
   struct LoadBalancedBackend backend;
+#ifdef VIGOR_MAP
+  if (map_LoadBalancedFlow_get(balancer->state->flow_to_flow_id, flow,
+                               &flow_index) == 0) {
+#else//VIGOR_MAP
   if (map_get(balancer->state->flow_to_flow_id, flow, &flow_index) == 0) {
+#endif//VIGOR_MAP
     int backend_index = 0;
     int found = cht_find_preferred_available_backend(
         (uint64_t)LoadBalancedFlow_hash(flow), balancer->state->cht,
@@ -60,7 +71,12 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
         *vec_flow_id_to_backend_id = backend_index;
         vector_return(balancer->state->flow_id_to_backend_id, flow_index,
                       (void *)vec_flow_id_to_backend_id);
+#ifdef VIGOR_MAP
+        map_LoadBalancedFlow_put(balancer->state->flow_to_flow_id, vec_flow,
+                                 flow_index);
+#else//VIGOR_MAP
         map_put(balancer->state->flow_to_flow_id, vec_flow, flow_index);
+#endif//VIGOR_MAP
         vector_return(balancer->state->flow_heap, flow_index,
                       vec_flow); // another half is in the map
 
@@ -92,7 +108,12 @@ struct LoadBalancedBackend lb_get_backend(struct LoadBalancer *balancer,
       // could use `flow_key` just as well here, but
       // current impl of symbex models does not support
       // connecting a map with its keystore.
+#ifdef VIGOR_MAP
+      map_LoadBalancedFlow_erase(balancer->state->flow_to_flow_id, flow,
+                                 (void **)&flow_key);
+#else//VIGOR_MAP
       map_erase(balancer->state->flow_to_flow_id, flow, (void **)&flow_key);
+#endif//VIGOR_MAP
 
       dchain_free_index(balancer->state->flow_chain, flow_index);
       vector_return(balancer->state->flow_heap, flow_index, (void *)flow_key);
@@ -152,9 +173,16 @@ void lb_expire_flows(struct LoadBalancer *balancer, vigor_time_t time) {
   uint64_t time_u = (uint64_t)time; // OK because of the two asserts
   vigor_time_t last_time =
       time_u - balancer->flow_expiration_time * 1000; // us to ns
+#if VIGOR_BATCH_SIZE != 1
+  expire_items_single_map_budget(balancer->state->flow_chain,
+                                 balancer->state->flow_heap,
+                                 balancer->state->flow_to_flow_id, last_time,
+                                 VIGOR_EXPIRATION_BUDGET);
+#else
   expire_items_single_map(balancer->state->flow_chain,
                           balancer->state->flow_heap,
                           balancer->state->flow_to_flow_id, last_time);
+#endif
 }
 
 void lb_expire_backends(struct LoadBalancer *balancer, vigor_time_t time) {
@@ -163,7 +191,14 @@ void lb_expire_backends(struct LoadBalancer *balancer, vigor_time_t time) {
   uint64_t time_u = (uint64_t)time; // OK because of the two asserts
   vigor_time_t last_time =
       time_u - balancer->backend_expiration_time * 1000; // us to ns
+#if VIGOR_BATCH_SIZE != 1
+  expire_items_single_map_budget(balancer->state->active_backends,
+                                 balancer->state->backend_ips,
+                                 balancer->state->ip_to_backend_id, last_time,
+                                 VIGOR_EXPIRATION_BUDGET);
+#else
   expire_items_single_map(balancer->state->active_backends,
                           balancer->state->backend_ips,
                           balancer->state->ip_to_backend_id, last_time);
+#endif
 }
@@ -43,6 +43,12 @@ void nf_config_init(int argc, char **argv) {
         if (config.flow_capacity <= 0) {
           PARSE_ERROR("Flow capacity must be strictly positive.\n");
         }
+#ifdef VIGOR_RSS_HASH
+        if (config.flow_capacity > RSS_FLOW_HASHES) {
+          PARSE_ERROR("Flow capacity must be at most %d with RSS hashes.\n",
+                      RSS_FLOW_HASHES);
+        }
+#endif // VIGOR_RSS_HASH
         break;
 
       case 's':
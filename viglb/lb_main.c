@@ -6,20 +6,109 @@
 #include "nf-log.h"
 #include "nf-util.h"
 
+#ifdef VIGOR_MULTICORE
+#  include <stdio.h>
+#  include <rte_lcore.h>
+#  include <rte_ring.h>
+#  include <rte_ring_elem.h>
+#endif // VIGOR_MULTICORE
+
 struct nf_config config;
 
-struct LoadBalancer *balancer;
+VIGOR_LCORE_LOCAL struct LoadBalancer *balancer;
+
+#ifdef VIGOR_MULTICORE
+// Each lcore has its own balancer, but heartbeats from a backend only reach
+// one of them, so the lcore that receives a heartbeat passes it on to all
+// others through their rings, and they process it before their next packet.
+// Heartbeats that do not fit in a ring are dropped, as backends send them
+// again long before they expire.
+struct lb_heartbeat {
+  struct LoadBalancedFlow flow;
+  struct rte_ether_addr mac;
+  uint16_t device;
+};
+
+#  define LB_HEARTBEAT_RING_SIZE 1024
+
+// Indexed by lcore index; each lcore sets its own in nf_init
+static struct rte_ring *heartbeat_rings[RTE_MAX_LCORE];
+
+static bool lb_init_heartbeat_ring(void) {
+  int index = rte_lcore_index(rte_lcore_id());
+  char name[RTE_RING_NAMESIZE];
+  snprintf(name, sizeof(name), "LB_HEARTBEATS_%d", index);
+  struct rte_ring *ring = rte_ring_create_elem(
+      name, sizeof(struct lb_heartbeat), LB_HEARTBEAT_RING_SIZE,
+      rte_socket_id(), RING_F_SC_DEQ);
+  if (ring == NULL) {
+    NF_INFO("Cannot create the heartbeat ring of core %u", rte_lcore_id());
+    return false;
+  }
+  __atomic_store_n(&heartbeat_rings[index], ring, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void lb_broadcast_heartbeat(struct LoadBalancedFlow *flow,
+                                   struct rte_ether_addr mac, uint16_t device) {
+  struct lb_heartbeat heartbeat = { .flow = *flow, .mac = mac, .device = device };
+  int own_index = rte_lcore_index(rte_lcore_id());
+  for (unsigned index = 0; index < rte_lcore_count(); index++) {
+    struct rte_ring *ring =
+        __atomic_load_n(&heartbeat_rings[index], __ATOMIC_ACQUIRE);
+    // Lcores that are not initialized yet will get the next heartbeat
+    if ((int)index != own_index && ring != NULL) {
+      rte_ring_enqueue_elem(ring, &heartbeat, sizeof(heartbeat));
+    }
+  }
+}
+
+static void lb_process_broadcast_heartbeats(vigor_time_t now) {
+  struct rte_ring *ring = heartbeat_rings[rte_lcore_index(rte_lcore_id())];
+  struct lb_heartbeat heartbeats[32];
+  unsigned count;
+  do {
+    count = rte_ring_dequeue_burst_elem(ring, heartbeats, sizeof(heartbeats[0]),
+                                        RTE_DIM(heartbeats), NULL);
+    for (unsigned n = 0; n < count; n++) {
+      lb_process_heartbit(balancer, &heartbeats[n].flow, heartbeats[n].mac,
+                          heartbeats[n].device, now);
+    }
+  } while (count == RTE_DIM(heartbeats));
+}
+#endif // VIGOR_MULTICORE
 
 bool nf_init(void) {
   balancer = lb_allocate_balancer(
       config.flow_capacity, config.backend_capacity, config.cht_height,
       config.backend_expiration_time, config.flow_expiration_time);
+#ifdef VIGOR_MULTICORE
+  if (balancer != NULL && !lb_init_heartbeat_ring()) {
+    return false;
+  }
+#endif // VIGOR_MULTICORE
   return balancer != NULL;
 }
 
+#if VIGOR_BATCH_SIZE != 1
+void nf_tick(vigor_time_t now) {
+#ifdef VIGOR_MULTICORE
+  lb_process_broadcast_heartbeats(now);
+#endif // VIGOR_MULTICORE
+  lb_expire_flows(balancer, now);
+  lb_expire_backends(balancer, now);
+}
+#endif
+
 int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_time_t now) {
+#ifdef VIGOR_MULTICORE
+  lb_process_broadcast_heartbeats(now);
+#endif // VIGOR_MULTICORE
+
+#if VIGOR_BATCH_SIZE == 1
   lb_expire_flows(balancer, now);
   lb_expire_backends(balancer, now);
+#endif
 
   struct rte_ether_hdr *rte_ether_header = nf_then_get_rte_ether_header(buffer);
   uint8_t *ip_options;
@@ -46,6 +135,9 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_t
   if (device != config.wan_device) {
     NF_DEBUG("Processing heartbeat, device is %" PRIu16, device);
     lb_process_heartbit(balancer, &flow, rte_ether_header->s_addr, device, now);
+#ifdef VIGOR_MULTICORE
+    lb_broadcast_heartbeat(&flow, rte_ether_header->s_addr, device);
+#endif // VIGOR_MULTICORE
     return device;
   }
 
@@ -56,12 +148,22 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_t
   concretize_devices(&backend.nic, rte_eth_dev_count_avail());
 
   if (backend.nic != config.wan_device) {
+#if VIGOR_BATCH_SIZE != 1
+    // The batched build is unverified anyway, and can adjust the checksums
+    // instead of summing the whole packet again
+    nf_update_rte_ipv4_udptcp_checksum(rte_ipv4_header, tcpudp_header,
+                                       rte_ipv4_header->dst_addr, backend.ip,
+                                       tcpudp_header->dst_port,
+                                       tcpudp_header->dst_port);
+#endif
     rte_ipv4_header->dst_addr = backend.ip;
     rte_ether_header->s_addr = config.device_macs[backend.nic];
     rte_ether_header->d_addr = backend.mac;
 
+#if VIGOR_BATCH_SIZE == 1
     // Checksum
     nf_set_rte_ipv4_udptcp_checksum(rte_ipv4_header, tcpudp_header, buffer);
+#endif
   }
 
   return backend.nic;
@@ -18,5 +18,7 @@ let constraints = ["flow_consistency", ( "FlowId",
                                                t=Unknown};
                                          ])]
 
+let record_groups = [["fv"; "heap"]]
+
 let gen_custom_includes = ref []
 let gen_records = ref []
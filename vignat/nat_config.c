@@ -77,12 +77,17 @@ void nf_config_init(int argc, char **argv) {
         }
         break;
 
-      case 'f':
-        config.max_flows = nf_util_parse_int(optarg, "max-flows", 10, '\0');
-        if (config.max_flows <= 0) {
+      case 'f': {
+        uintmax_t max_flows = nf_util_parse_int(optarg, "max-flows", 10, '\0');
+        if (max_flows == 0) {
           PARSE_ERROR("Flow table size must be strictly positive.\n");
         }
+        if (max_flows > UINT16_MAX + 1) {
+          PARSE_ERROR("Flow table size must be at most %d.\n", UINT16_MAX + 1);
+        }
+        config.max_flows = max_flows;
         break;
+      }
 
       case 's':
         config.start_port = nf_util_parse_int(optarg, "start-port", 10, '\0');
@@ -101,6 +106,12 @@ void nf_config_init(int argc, char **argv) {
     }
   }
 
+  // Each flow uses its own external port
+  if (config.max_flows > (uint32_t)(UINT16_MAX + 1 - config.start_port)) {
+    PARSE_ERROR("Flow table size must be at most %d with starting port %" PRIu16
+                ".\n", UINT16_MAX + 1 - config.start_port, config.start_port);
+  }
+
   // Reset getopt
   optind = 1;
 }
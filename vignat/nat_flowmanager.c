@@ -9,6 +9,11 @@
 #include "libvig/verified/map.h"
 #include "libvig/verified/vector.h"
 #include "libvig/verified/expirator.h"
+#if VIGOR_BATCH_SIZE != 1
+// The batched build is unverified anyway, and can hash keys only once
+#  include "libvig/unverified/map-ext.h"
+#  include "libvig/unverified/expirator-ext.h"
+#endif
 
 #include "state.h"
 
@@ -54,14 +59,70 @@ bool flow_manager_allocate_flow(struct FlowManager *manager, struct FlowId *id,
   return true;
 }
 
+#if VIGOR_BATCH_SIZE != 1
+bool flow_manager_get_or_allocate_internal(struct FlowManager *manager,
+                                           struct FlowId *id, unsigned hash,
+                                           vigor_time_t time,
+                                           uint16_t *external_port) {
+  int index;
+  struct MapReservation reservation;
+#ifdef VIGOR_MAP
+  if (map_FlowId_get_or_reserve_hashed(manager->state->fm, id, hash, &index,
+                                       &reservation)) {
+#else//VIGOR_MAP
+  if (map_get_or_reserve_hashed(manager->state->fm, id, hash, &index,
+                                &reservation)) {
+#endif//VIGOR_MAP
+    *external_port = index + manager->state->start_port;
+    dchain_rejuvenate_index(manager->state->heap, index, time);
+    return true;
+  }
+
+  if (dchain_allocate_new_index(manager->state->heap, &index, time) == 0) {
+    return false;
+  }
+
+  *external_port = manager->state->start_port + index;
+
+#ifdef STATE_STATIC_FV_RECORDS
+  // The records are at a fixed address, see state.h
+  struct FlowId *key = state_fv_at(index);
+#else//STATE_STATIC_FV_RECORDS
+  struct FlowId *key = 0;
+  vector_borrow(manager->state->fv, index, (void **)&key);
+#endif//STATE_STATIC_FV_RECORDS
+  memcpy((void *)key, (void *)id, sizeof(struct FlowId));
+#ifdef VIGOR_MAP
+  map_FlowId_commit(manager->state->fm, &reservation, key, index);
+#else//VIGOR_MAP
+  map_commit(manager->state->fm, &reservation, key, index);
+#endif//VIGOR_MAP
+#ifndef STATE_STATIC_FV_RECORDS
+  vector_return(manager->state->fv, index, key);
+#endif//STATE_STATIC_FV_RECORDS
+  return true;
+}
+
+void flow_manager_prefetch_internal(struct FlowManager *manager,
+                                    unsigned hash) {
+  map_prefetch_hashed(manager->state->fm, hash);
+}
+#endif
+
 void flow_manager_expire(struct FlowManager *manager, vigor_time_t time) {
   assert(time >= 0); // we don't support the past
   assert(sizeof(vigor_time_t) <= sizeof(uint64_t));
   uint64_t time_u = (uint64_t)time; // OK because of the two asserts
   vigor_time_t last_time =
       time_u - manager->expiration_time * 1000; // convert us to ns
+#if VIGOR_BATCH_SIZE != 1
+  expire_items_single_map_budget(manager->state->heap, manager->state->fv,
+                                 manager->state->fm, last_time,
+                                 VIGOR_EXPIRATION_BUDGET);
+#else
   expire_items_single_map(manager->state->heap, manager->state->fv,
                           manager->state->fm, last_time);
+#endif
 }
 
 bool flow_manager_get_internal(struct FlowManager *manager, struct FlowId *id,
@@ -83,10 +144,14 @@ bool flow_manager_get_external(struct FlowManager *manager,
     return false;
   }
 
+#ifdef STATE_STATIC_FV_RECORDS
+  memcpy((void *)out_flow, (void *)state_fv_at(index), sizeof(struct FlowId));
+#else//STATE_STATIC_FV_RECORDS
   struct FlowId *key = 0;
   vector_borrow(manager->state->fv, index, (void **)&key);
   memcpy((void *)out_flow, (void *)key, sizeof(struct FlowId));
   vector_return(manager->state->fv, index, key);
+#endif//STATE_STATIC_FV_RECORDS
 
   dchain_rejuvenate_index(manager->state->heap, index, time);
 
@@ -3,6 +3,7 @@
 
 #include "flow.h.gen.h"
 #include "libvig/verified/vigor-time.h"
+#include "nf.h"
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -20,6 +21,20 @@ flow_manager_allocate(uint16_t starting_port, uint32_t nat_ip,
 bool flow_manager_allocate_flow(struct FlowManager *manager, struct FlowId *id,
                                 uint16_t internal_device, vigor_time_t time,
                                 uint16_t *external_port);
+#if VIGOR_BATCH_SIZE != 1
+// flow_manager_get_internal, then flow_manager_allocate_flow if the flow is
+// not found, hashing and probing the flow table only once; the hash of the
+// flow ID must be already computed, e.g. by FlowId_hash or nf_rss_hash
+bool flow_manager_get_or_allocate_internal(struct FlowManager *manager,
+                                           struct FlowId *id, unsigned hash,
+                                           vigor_time_t time,
+                                           uint16_t *external_port);
+
+// Prefetches what flow_manager_get_or_allocate_internal looks up first for a
+// flow ID with the given hash
+void flow_manager_prefetch_internal(struct FlowManager *manager, unsigned hash);
+#endif
+
 void flow_manager_expire(struct FlowManager *manager, vigor_time_t time);
 bool flow_manager_get_internal(struct FlowManager *manager, struct FlowId *id,
                                vigor_time_t time, uint16_t *external_port);
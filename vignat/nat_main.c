@@ -7,14 +7,97 @@
 #include "nf-log.h"
 #include "nf-util.h"
 
+#ifdef VIGOR_MULTICORE
+#  include <rte_flow.h>
+#  include <rte_lcore.h>
+#endif // VIGOR_MULTICORE
+
 struct nf_config config;
 
-struct FlowManager *flow_manager;
+VIGOR_LCORE_LOCAL struct FlowManager *flow_manager;
+
+#ifdef VIGOR_MULTICORE
+// Installs a rule on the WAN device that sends packets to the external IP
+// whose L4 destination port matches the given spec and mask to the given queue
+static bool nat_steer_port_range(enum rte_flow_item_type l4_type,
+                                 const void *l4_spec, const void *l4_mask,
+                                 uint16_t queue) {
+  struct rte_flow_attr attr = { .ingress = 1 };
+  struct rte_flow_item_ipv4 ip_spec = { .hdr.dst_addr = config.external_addr };
+  struct rte_flow_item_ipv4 ip_mask = { .hdr.dst_addr = UINT32_MAX };
+  struct rte_flow_item pattern[] = {
+    { .type = RTE_FLOW_ITEM_TYPE_ETH },
+    { .type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip_spec, .mask = &ip_mask },
+    { .type = l4_type, .spec = l4_spec, .mask = l4_mask },
+    { .type = RTE_FLOW_ITEM_TYPE_END }
+  };
+  struct rte_flow_action_queue queue_action = { .index = queue };
+  struct rte_flow_action actions[] = {
+    { .type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue_action },
+    { .type = RTE_FLOW_ACTION_TYPE_END }
+  };
+
+  struct rte_flow_error error;
+  if (rte_flow_create(config.wan_device, &attr, pattern, actions, &error) == NULL) {
+    NF_INFO("Cannot steer external ports to queue %" PRIu16 ": %s", queue,
+            error.message == NULL ? "unknown error" : error.message);
+    return false;
+  }
+  return true;
+}
+
+// Each lcore allocates external ports in its own slice of the port range;
+// RSS cannot know which lcore that is for replies, so we steer them with
+// flow rules, which requires slices to be aligned powers of 2
+static bool nat_steer_replies(uint32_t flows_per_lcore) {
+  if (flows_per_lcore == 0 ||
+      (flows_per_lcore & (flows_per_lcore - 1)) != 0 ||
+      config.start_port % flows_per_lcore != 0 ||
+      config.start_port + flows_per_lcore * rte_lcore_count() > UINT16_MAX + 1) {
+    NF_INFO("With multiple cores, the flow table capacity per core must be "
+            "a power of 2 that divides the starting port, and all ports must "
+            "fit after the starting port.");
+    return false;
+  }
+
+  for (uint16_t queue = 0; queue < rte_lcore_count(); queue++) {
+    // External ports are written as-is in the packets,
+    // see flow_manager_allocate_flow
+    uint16_t port = config.start_port + queue * flows_per_lcore;
+    uint16_t port_mask = ~(flows_per_lcore - 1);
+    struct rte_flow_item_tcp tcp_spec = { .hdr.dst_port = port };
+    struct rte_flow_item_tcp tcp_mask = { .hdr.dst_port = port_mask };
+    struct rte_flow_item_udp udp_spec = { .hdr.dst_port = port };
+    struct rte_flow_item_udp udp_mask = { .hdr.dst_port = port_mask };
+    if (!nat_steer_port_range(RTE_FLOW_ITEM_TYPE_TCP, &tcp_spec, &tcp_mask,
+                              queue) ||
+        !nat_steer_port_range(RTE_FLOW_ITEM_TYPE_UDP, &udp_spec, &udp_mask,
+                              queue)) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif // VIGOR_MULTICORE
 
 bool nf_init(void) {
+  uint16_t start_port = config.start_port;
+  uint32_t max_flows = config.max_flows;
+
+#ifdef VIGOR_MULTICORE
+  // Split the flow table and the external ports among lcores
+  uint16_t queue = rte_lcore_index(rte_lcore_id());
+  max_flows = config.max_flows / rte_lcore_count();
+  start_port = config.start_port + queue * max_flows;
+  // Flow rules are per device, and must not be created concurrently
+  if (queue == 0 && !nat_steer_replies(max_flows)) {
+    return false;
+  }
+#endif // VIGOR_MULTICORE
+
   flow_manager = flow_manager_allocate(
-      config.start_port, config.external_addr, config.wan_device,
-      config.expiration_time, config.max_flows);
+      start_port, config.external_addr, config.wan_device,
+      config.expiration_time, max_flows);
 
   return flow_manager != NULL;
 }
@@ -107,3 +190,136 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_t
 
   return dst_device;
 }
+
+#if VIGOR_BATCH_SIZE != 1
+void nf_tick(vigor_time_t now) {
+  flow_manager_expire(flow_manager, now);
+}
+
+// Gets the ID of the flow of the given packet from an internal device,
+// and returns its hash
+static unsigned internal_flow_id(uint16_t device, struct rte_mbuf *mbuf,
+                                 struct rte_ipv4_hdr *rte_ipv4_header,
+                                 struct tcpudp_hdr *tcpudp_header,
+                                 struct FlowId *id) {
+  *id = (struct FlowId){ .src_port = tcpudp_header->src_port,
+                         .dst_port = tcpudp_header->dst_port,
+                         .src_ip = rte_ipv4_header->src_addr,
+                         .dst_ip = rte_ipv4_header->dst_addr,
+                         .protocol = rte_ipv4_header->next_proto_id,
+                         .internal_device = device };
+#ifdef VIGOR_RSS_HASH
+  return nf_rss_hash(mbuf, rte_ipv4_header, tcpudp_header);
+#else
+  (void)mbuf;
+  return FlowId_hash(id);
+#endif
+}
+
+// What nf_prefetch finds in each packet of the current burst
+struct burst_packet {
+  struct rte_ether_hdr *rte_ether_header;
+  struct rte_ipv4_hdr *rte_ipv4_header;
+  struct tcpudp_hdr *tcpudp_header; // NULL if the packet is dropped
+  struct FlowId id;                 // if the packet is from an internal device
+  unsigned hash;                    // likewise
+};
+static VIGOR_LCORE_LOCAL struct burst_packet burst[VIGOR_BATCH_SIZE];
+
+// Parses all packets first, as they arrive...
+void nf_prefetch(uint16_t device, struct rte_mbuf *mbuf, uint16_t n) {
+  struct burst_packet *packet = &burst[n];
+  // Packets the device knows are not IPv4 TCP/UDP are dropped unread
+  if (!nf_ptype_may_be_tcpudp(nf_packet_type(mbuf))) {
+    packet->tcpudp_header = NULL;
+    return;
+  }
+  nf_get_headers(mbuf, &packet->rte_ether_header, &packet->rte_ipv4_header,
+                 &packet->tcpudp_header);
+  // Flows from the external device are found by port, without hashing
+  if ((device != config.wan_device) & (packet->tcpudp_header != NULL)) {
+    packet->hash = internal_flow_id(device, mbuf, packet->rte_ipv4_header,
+                                    packet->tcpudp_header, &packet->id);
+    flow_manager_prefetch_internal(flow_manager, packet->hash);
+  }
+}
+
+void nf_process_batch(uint16_t device, struct rte_mbuf **mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t *dst_devices) {
+  // ...then look up all flows, in order since packets may allocate flows...
+  struct FlowId internal_flows[VIGOR_BATCH_SIZE];
+  uint16_t external_ports[VIGOR_BATCH_SIZE];
+  for (uint16_t n = 0; n < count; n++) {
+    struct burst_packet *packet = &burst[n];
+    dst_devices[n] = device;
+    if (packet->tcpudp_header == NULL) {
+      NF_DEBUG("Not IPv4 TCP/UDP, dropping");
+      continue;
+    }
+
+    if (device == config.wan_device) {
+      if (!flow_manager_get_external(flow_manager,
+                                     packet->tcpudp_header->dst_port, now,
+                                     &internal_flows[n])) {
+        NF_DEBUG("Unknown flow, dropping");
+        continue;
+      }
+      if (internal_flows[n].dst_ip != packet->rte_ipv4_header->src_addr |
+          internal_flows[n].dst_port != packet->tcpudp_header->src_port |
+          internal_flows[n].protocol != packet->rte_ipv4_header->next_proto_id) {
+        NF_DEBUG("Spoofing attempt, dropping.");
+        continue;
+      }
+      dst_devices[n] = internal_flows[n].internal_device;
+    } else {
+      if (!flow_manager_get_or_allocate_internal(flow_manager, &packet->id,
+                                                 packet->hash, now,
+                                                 &external_ports[n])) {
+        NF_DEBUG("No space for the flow, dropping");
+        continue;
+      }
+      dst_devices[n] = config.wan_device;
+    }
+  }
+
+  // ...and finally rewrite the packets we forward
+  for (uint16_t n = 0; n < count; n++) {
+    if (dst_devices[n] == device) {
+      continue;
+    }
+
+    struct burst_packet *packet = &burst[n];
+    uint32_t old_addr, new_addr;
+    uint16_t old_port, new_port;
+    if (device == config.wan_device) {
+      old_addr = packet->rte_ipv4_header->dst_addr;
+      old_port = packet->tcpudp_header->dst_port;
+      new_addr = internal_flows[n].src_ip;
+      new_port = internal_flows[n].src_port;
+      packet->rte_ipv4_header->dst_addr = new_addr;
+      packet->tcpudp_header->dst_port = new_port;
+    } else {
+      old_addr = packet->rte_ipv4_header->src_addr;
+      old_port = packet->tcpudp_header->src_port;
+      new_addr = config.external_addr;
+      new_port = external_ports[n];
+      packet->rte_ipv4_header->src_addr = new_addr;
+      packet->tcpudp_header->src_port = new_port;
+    }
+
+    // Let the device compute the checksums if it can, otherwise adjust them
+    // for the rewritten fields instead of summing the whole packet again
+    if (nf_tx_cksum_offload[dst_devices[n]]) {
+      nf_offload_rte_ipv4_udptcp_checksum(mbufs[n], packet->rte_ipv4_header,
+                                          packet->tcpudp_header);
+    } else {
+      nf_update_rte_ipv4_udptcp_checksum(packet->rte_ipv4_header,
+                                         packet->tcpudp_header, old_addr,
+                                         new_addr, old_port, new_port);
+    }
+
+    packet->rte_ether_header->s_addr = config.device_macs[dst_devices[n]];
+    packet->rte_ether_header->d_addr = config.endpoint_macs[dst_devices[n]];
+  }
+}
+#endif
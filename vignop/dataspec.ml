@@ -6,5 +6,6 @@ let containers = []
 let custom_includes = []
 
 let constraints = []
+let record_groups : string list list = []
 let gen_custom_includes : string list ref = ref []
 let gen_records : (string * ttype) list ref = ref []
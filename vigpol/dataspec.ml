@@ -17,6 +17,8 @@ let constraints = ["dyn_val_condition", ( "DynamicValue",
                                            Bop (Le, {t=Unknown;v=Id "bucket_size"}, {t=Unknown;v=Int 3750000000});
                                           ])]
 
+let record_groups = [["dyn_keys"; "dyn_vals"; "dyn_heap"]]
+
 let gen_custom_includes = ref []
 let gen_records = ref []
 
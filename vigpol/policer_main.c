@@ -14,10 +14,21 @@
 #include "libvig/verified/map.h"
 #include "libvig/verified/vector.h"
 #include "libvig/verified/expirator.h"
+#if VIGOR_BATCH_SIZE != 1
+// The batched build is unverified anyway, and can hash keys only once
+#  include "libvig/unverified/map-ext.h"
+#  include "libvig/unverified/expirator-ext.h"
+#endif
+
+#ifdef VIGOR_MULTICORE
+#  include <rte_byteorder.h>
+#  include <rte_flow.h>
+#  include <rte_lcore.h>
+#endif // VIGOR_MULTICORE
 
 struct nf_config config;
 
-struct State *dynamic_ft;
+VIGOR_LCORE_LOCAL struct State *dynamic_ft;
 
 int policer_expire_entries(vigor_time_t time) {
   assert(time >= 0); // we don't support the past
@@ -27,13 +38,25 @@ int policer_expire_entries(vigor_time_t time) {
   // OK because time >= config.burst / config.rate >= 0
   vigor_time_t min_time = time_u - exp_time;
 
+#if VIGOR_BATCH_SIZE != 1
+  return expire_items_single_map_budget(dynamic_ft->dyn_heap,
+                                        dynamic_ft->dyn_keys, dynamic_ft->dyn_map,
+                                        min_time, VIGOR_EXPIRATION_BUDGET);
+#else
   return expire_items_single_map(dynamic_ft->dyn_heap, dynamic_ft->dyn_keys,
                                  dynamic_ft->dyn_map, min_time);
+#endif
 }
 
 bool policer_check_tb(uint32_t dst, uint16_t size, vigor_time_t time) {
   int index = -1;
+#if VIGOR_BATCH_SIZE != 1
+  struct MapReservation reservation;
+  int present =
+      map_get_or_reserve(dynamic_ft->dyn_map, &dst, &index, &reservation);
+#else
   int present = map_get(dynamic_ft->dyn_map, &dst, &index);
+#endif
   if (present) {
     dchain_rejuvenate_index(dynamic_ft->dyn_heap, index, time);
 
@@ -92,7 +115,11 @@ bool policer_check_tb(uint32_t dst, uint16_t size, vigor_time_t time) {
     *key = dst;
     value->bucket_size = config.burst - size;
     value->bucket_time = time;
+#if VIGOR_BATCH_SIZE != 1
+    map_commit(dynamic_ft->dyn_map, &reservation, key, index);
+#else
     map_put(dynamic_ft->dyn_map, key, index);
+#endif
     // the other half of the key is in the map
     vector_return(dynamic_ft->dyn_keys, index, key);
     vector_return(dynamic_ft->dyn_vals, index, value);
@@ -102,8 +129,57 @@ bool policer_check_tb(uint32_t dst, uint16_t size, vigor_time_t time) {
   }
 }
 
+#ifdef VIGOR_MULTICORE
+// Each lcore has its own buckets, so all packets to a given IP must reach the
+// same lcore for the rate to hold; RSS hashes the source as well, so we steer
+// them with flow rules on the low bits of the destination IP instead, which
+// requires the number of lcores to be a power of 2
+static bool policer_steer_destinations(void) {
+  uint32_t lcores = rte_lcore_count();
+  if ((lcores & (lcores - 1)) != 0) {
+    NF_INFO("With multiple cores, the number of cores must be a power of 2.");
+    return false;
+  }
+
+  for (uint16_t queue = 0; queue < lcores; queue++) {
+    struct rte_flow_attr attr = { .ingress = 1 };
+    struct rte_flow_item_ipv4 ip_spec = {
+      .hdr.dst_addr = rte_cpu_to_be_32(queue)
+    };
+    struct rte_flow_item_ipv4 ip_mask = {
+      .hdr.dst_addr = rte_cpu_to_be_32(lcores - 1)
+    };
+    struct rte_flow_item pattern[] = {
+      { .type = RTE_FLOW_ITEM_TYPE_ETH },
+      { .type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip_spec, .mask = &ip_mask },
+      { .type = RTE_FLOW_ITEM_TYPE_END }
+    };
+    struct rte_flow_action_queue queue_action = { .index = queue };
+    struct rte_flow_action actions[] = {
+      { .type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue_action },
+      { .type = RTE_FLOW_ACTION_TYPE_END }
+    };
+
+    struct rte_flow_error error;
+    if (rte_flow_create(config.wan_device, &attr, pattern, actions, &error) ==
+        NULL) {
+      NF_INFO("Cannot steer destination IPs to queue %" PRIu16 ": %s", queue,
+              error.message == NULL ? "unknown error" : error.message);
+      return false;
+    }
+  }
+  return true;
+}
+#endif // VIGOR_MULTICORE
+
 bool nf_init(void) {
   unsigned capacity = config.dyn_capacity;
+#ifdef VIGOR_MULTICORE
+  // Flow rules are per device, and must not be created concurrently
+  if (rte_lcore_index(rte_lcore_id()) == 0 && !policer_steer_destinations()) {
+    return false;
+  }
+#endif // VIGOR_MULTICORE
   dynamic_ft = alloc_state(capacity, rte_eth_dev_count_avail());
   return dynamic_ft != NULL;
 }
@@ -143,3 +219,44 @@ int nf_process(uint16_t device, uint8_t* buffer, uint16_t packet_length, vigor_t
     return device;
   }
 }
+
+#if VIGOR_BATCH_SIZE != 1
+void nf_tick(vigor_time_t now) {
+  policer_expire_entries(now);
+}
+
+void nf_process_batch(uint16_t device, struct rte_mbuf **mbufs, uint16_t count,
+                      vigor_time_t now, uint16_t *dst_devices) {
+  // Parse all packets first...
+  struct rte_ipv4_hdr *rte_ipv4_headers[VIGOR_BATCH_SIZE];
+  for (uint16_t n = 0; n < count; n++) {
+    // Packets the device knows are not IPv4 are dropped unread
+    if (!nf_ptype_may_be_ipv4(nf_packet_type(mbufs[n]))) {
+      rte_ipv4_headers[n] = NULL;
+      continue;
+    }
+    struct rte_ether_hdr *rte_ether_header;
+    struct tcpudp_hdr *tcpudp_header;
+    nf_get_headers(mbufs[n], &rte_ether_header, &rte_ipv4_headers[n],
+                   &tcpudp_header);
+  }
+
+  // ...then police all packets, in order since they share buckets
+  for (uint16_t n = 0; n < count; n++) {
+    if (rte_ipv4_headers[n] == NULL) {
+      NF_DEBUG("Not IPv4, dropping");
+      dst_devices[n] = device;
+    } else if (device == config.lan_device) {
+      NF_DEBUG("Outgoing packet. Not policing.");
+      dst_devices[n] = config.wan_device;
+    } else if (device == config.wan_device) {
+      bool fwd = policer_check_tb(rte_ipv4_headers[n]->dst_addr,
+                                  mbufs[n]->pkt_len, now);
+      dst_devices[n] = fwd ? config.lan_device : config.wan_device;
+    } else {
+      NF_DEBUG("Unknown port. Dropping.");
+      dst_devices[n] = device;
+    }
+  }
+}
+#endif